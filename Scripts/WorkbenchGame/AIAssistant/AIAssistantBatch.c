@@ -0,0 +1,580 @@
+//-----------------------------------------------------------------------------
+//! Batch documentation and analysis over a script folder
+//! Files are split at class and method boundaries and the chunks go through the
+//! bridge with bounded parallelism. Each finished file gets a Markdown report
+//! next to its source. Completed chunks are checkpointed, so a restarted job
+//! only sends chunks that are missing or changed.
+//-----------------------------------------------------------------------------
+
+class AIBatchJob;
+class AIBatchChunkCallback;
+
+//! One unit of batch work: a class, a method of a large class, or a whole file
+class AIBatchChunk
+{
+	string label;
+	string text;
+	//! Path, label and content hash; an unchanged chunk is answered from the checkpoint
+	string key;
+	string result;
+	bool isPending;
+	bool isFinished;
+	bool hasFailed;
+	ref AIRequest request;
+	ref AIBatchChunkCallback callback;
+}
+
+//-----------------------------------------------------------------------------
+//! Batch state of one source file
+class AIBatchFile
+{
+	string path;
+	//! Full source, kept while the file's chunks are open
+	string text;
+	//! Comments and declarations before the first class, sent with every chunk
+	string header;
+	ref array<ref AIBatchChunk> chunks;
+	int nextChunk;
+	int remaining;
+	//! Set when every chunk came from the checkpoint
+	bool isResumed;
+
+	void AIBatchFile()
+	{
+		chunks = {};
+		nextChunk = 0;
+		remaining = 0;
+		isResumed = false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Routes the outcome of one chunk back to its job
+class AIBatchChunkCallback : AIResponseCallback
+{
+	protected AIBatchJob m_Job;
+	protected AIBatchFile m_File;
+	protected AIBatchChunk m_Chunk;
+
+	void AIBatchChunkCallback(AIBatchJob job, AIBatchFile file, AIBatchChunk chunk)
+	{
+		m_Job = job;
+		m_File = file;
+		m_Chunk = chunk;
+	}
+
+	override void OnSuccess(string response)
+	{
+		m_Job.OnChunkFinished(m_File, m_Chunk, response, "");
+	}
+
+	override void OnError(string error)
+	{
+		m_Job.OnChunkFinished(m_File, m_Chunk, "", error);
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Runs DOCUMENTATION or CODE_ANALYSIS over every script under a root
+//! At most `parallelism` chunks are in flight; the core's concurrency limit and
+//! the batch priority keep interactive requests ahead of the job. Files are
+//! read and split lazily, in time-sliced call-queue steps.
+class AIBatchJob
+{
+	protected static const int CHECKPOINT_VERSION = 1;
+	//! Classes longer than this are sent method by method
+	protected static const int MAX_CHUNK_CHARS = 12000;
+	//! Time one pump step may spend reading files and sending chunks
+	protected static const int PUMP_BUDGET_MS = 50;
+
+	protected AIAssistantCore m_Core;
+	protected AIRequestType m_Type;
+	protected string m_Root;
+	protected string m_Instructions;
+	protected string m_CheckpointPath;
+	protected int m_Parallelism;
+	protected ref array<string> m_Paths;
+	protected int m_NextPath;
+	protected ref array<ref AIBatchFile> m_OpenFiles;
+	//! Chunk key to result, from the checkpoint and this run
+	protected ref map<string, string> m_Completed;
+	protected bool m_IsRunning;
+	protected bool m_IsPumpScheduled;
+	protected int m_PumpStartTick;
+	protected int m_InFlight;
+	protected int m_StartTick;
+	protected int m_EndTick;
+	protected int m_FilesDone;
+	protected int m_FilesResumed;
+	protected int m_ChunksSent;
+	protected int m_ChunksFailed;
+	protected int m_Tokens;
+
+	//-----------------------------------------------------------------------------
+	void AIBatchJob(AIAssistantCore core, AIRequestType type, string root, string instructions, string checkpointPath, int parallelism)
+	{
+		m_Core = core;
+		m_Type = type;
+		m_Root = root;
+		m_Instructions = instructions;
+		m_CheckpointPath = checkpointPath;
+		m_Parallelism = Math.Max(1, parallelism);
+		m_Paths = {};
+		m_NextPath = 0;
+		m_OpenFiles = {};
+		m_Completed = new map<string, string>();
+		m_IsRunning = false;
+		m_IsPumpScheduled = false;
+		m_InFlight = 0;
+		m_StartTick = 0;
+		m_EndTick = 0;
+		m_FilesDone = 0;
+		m_FilesResumed = 0;
+		m_ChunksSent = 0;
+		m_ChunksFailed = 0;
+		m_Tokens = 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	void ~AIBatchJob()
+	{
+		GetGame().GetCallqueue().Remove(Pump);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Enumerate the scripts and start sending; false when nothing was found
+	bool Start()
+	{
+		FileIO.FindFiles(OnScriptFound, m_Root, ".c");
+		if (m_Paths.IsEmpty())
+			return false;
+
+		m_Paths.Sort();
+		LoadCheckpoint();
+
+		m_IsRunning = true;
+		m_StartTick = System.GetTickCount();
+		Print(string.Format("[AI Copilot] Batch %1 started over %2 files in %3 (%4 chunks checkpointed)", GetTypeLabel(), m_Paths.Count(), m_Root, m_Completed.Count()));
+
+		SchedulePump();
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Stop sending and cancel the chunks in flight; the checkpoint is kept
+	void Stop()
+	{
+		if (!m_IsRunning)
+			return;
+
+		m_IsRunning = false;
+		m_EndTick = System.GetTickCount();
+		GetGame().GetCallqueue().Remove(Pump);
+		m_IsPumpScheduled = false;
+
+		foreach (AIBatchFile file : m_OpenFiles)
+		{
+			foreach (AIBatchChunk chunk : file.chunks)
+			{
+				if (chunk.isPending && chunk.request)
+					m_Core.CancelRequest(chunk.request.requestId);
+			}
+		}
+
+		Print("[AI Copilot] Batch stopped: " + GetStatusText());
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void OnScriptFound(string fileName, FileAttribute attributes = 0, string filesystem = string.Empty)
+	{
+		if (fileName.EndsWith(".c"))
+			m_Paths.Insert(fileName);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Called by the chunk callbacks; the chunk objects stay alive until the next pump
+	void OnChunkFinished(AIBatchFile file, AIBatchChunk chunk, string response, string error)
+	{
+		if (!chunk.isPending)
+			return;
+
+		chunk.isPending = false;
+		m_InFlight--;
+
+		if (!m_IsRunning)
+			return;
+
+		chunk.isFinished = true;
+		file.remaining--;
+
+		if (error.IsEmpty())
+		{
+			chunk.result = response;
+			m_Completed.Set(chunk.key, response);
+			AppendCheckpoint(chunk);
+			m_Tokens += CountTokens(chunk.request, response);
+		}
+		else
+		{
+			chunk.result = "_" + error + "_";
+			chunk.hasFailed = true;
+			m_ChunksFailed++;
+		}
+
+		if (file.remaining == 0)
+			FinishFile(file);
+
+		SchedulePump();
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void SchedulePump()
+	{
+		if (m_IsPumpScheduled)
+			return;
+
+		m_IsPumpScheduled = true;
+		GetGame().GetCallqueue().CallLater(Pump, 0, false);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Drop finished files and fill the free slots, reading files as needed
+	protected void Pump()
+	{
+		m_IsPumpScheduled = false;
+		if (!m_IsRunning)
+			return;
+
+		for (int i = m_OpenFiles.Count() - 1; i >= 0; i--)
+		{
+			if (m_OpenFiles[i].remaining == 0)
+				m_OpenFiles.RemoveOrdered(i);
+		}
+
+		m_PumpStartTick = System.GetTickCount();
+		while (m_InFlight < m_Parallelism)
+		{
+			AIBatchFile file;
+			AIBatchChunk chunk;
+			if (!NextChunk(file, chunk))
+				break;
+
+			SendChunk(file, chunk);
+
+			// Building prompts costs time too; with many free slots, continue later
+			if (System.GetTickCount() - m_PumpStartTick >= PUMP_BUDGET_MS)
+			{
+				SchedulePump();
+				break;
+			}
+		}
+
+		if (m_IsPumpScheduled)
+			return;
+
+		if (m_InFlight == 0 && m_OpenFiles.IsEmpty() && m_NextPath >= m_Paths.Count())
+		{
+			m_IsRunning = false;
+			m_EndTick = System.GetTickCount();
+			Print("[AI Copilot] Batch finished: " + GetStatusText());
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//! The next unsent chunk, opening further files when the open ones are exhausted
+	//! Once the pump budget is spent, the rest is left to another pump step
+	protected bool NextChunk(out AIBatchFile file, out AIBatchChunk chunk)
+	{
+		foreach (AIBatchFile openFile : m_OpenFiles)
+		{
+			while (openFile.nextChunk < openFile.chunks.Count())
+			{
+				AIBatchChunk candidate = openFile.chunks[openFile.nextChunk];
+				openFile.nextChunk++;
+				if (!candidate.isFinished)
+				{
+					file = openFile;
+					chunk = candidate;
+					return true;
+				}
+			}
+		}
+
+		while (m_NextPath < m_Paths.Count())
+		{
+			if (System.GetTickCount() - m_PumpStartTick >= PUMP_BUDGET_MS)
+			{
+				SchedulePump();
+				return false;
+			}
+
+			AIBatchFile opened = OpenFile(m_Paths[m_NextPath]);
+			m_NextPath++;
+			if (!opened)
+				continue;
+
+			// Fully checkpointed files only need their report rewritten
+			if (opened.remaining == 0)
+			{
+				FinishFile(opened);
+				continue;
+			}
+
+			m_OpenFiles.Insert(opened);
+			return NextChunk(file, chunk);
+		}
+
+		return false;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Read and split a file; chunks found in the checkpoint are already finished
+	protected AIBatchFile OpenFile(string path)
+	{
+		string text;
+		if (!AIFileUtils.ReadAll(path, text))
+		{
+			Print("[AI Copilot] Batch could not read " + path, LogLevel.WARNING);
+			return null;
+		}
+
+		AIBatchFile file = new AIBatchFile();
+		file.path = path;
+		file.text = text;
+		file.header = AIPromptBuilder.ExtractFileHeader(text);
+		SplitIntoChunks(file);
+
+		foreach (AIBatchChunk chunk : file.chunks)
+		{
+			string result;
+			if (m_Completed.Find(chunk.key, result))
+			{
+				chunk.result = result;
+				chunk.isFinished = true;
+			}
+			else
+			{
+				file.remaining++;
+			}
+		}
+
+		file.isResumed = file.remaining == 0;
+		return file;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Top-level classes and functions become chunks; a class too long for one
+	//! chunk is sent method by method, and a file without definitions whole
+	protected void SplitIntoChunks(AIBatchFile file)
+	{
+		array<ref AICodeSymbol> symbols = {};
+		AICodeScanner.Scan(file.text, file.path, symbols);
+
+		foreach (AICodeSymbol symbol : symbols)
+		{
+			if (!symbol.parent.IsEmpty())
+				continue;
+
+			if (symbol.kind == AICodeSymbolKind.METHOD || symbol.length <= MAX_CHUNK_CHARS)
+			{
+				AddChunk(file, GetSymbolLabel(symbol), symbol.start, symbol.length);
+				continue;
+			}
+
+			foreach (AICodeSymbol member : symbols)
+			{
+				if (member.kind == AICodeSymbolKind.METHOD && member.parent == symbol.name && member.start >= symbol.start && member.start < symbol.start + symbol.length)
+					AddChunk(file, GetSymbolLabel(member), member.start, member.length);
+			}
+		}
+
+		if (file.chunks.IsEmpty() && !file.text.Trim().IsEmpty())
+			AddChunk(file, "file", 0, file.text.Length());
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void AddChunk(AIBatchFile file, string label, int start, int length)
+	{
+		if (start < 0 || length <= 0 || start + length > file.text.Length())
+			return;
+
+		AIBatchChunk chunk = new AIBatchChunk();
+		chunk.label = label;
+		chunk.text = file.text.Substring(start, length);
+		chunk.key = string.Format("%1|%2|%3", file.path, label, chunk.text.Hash());
+		file.chunks.Insert(chunk);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! e.g. "class SCR_Foo" or "method SCR_Foo.OnPostInit"
+	protected static string GetSymbolLabel(AICodeSymbol symbol)
+	{
+		string label = EnumToString(typeof(AICodeSymbolKind), symbol.kind);
+		label.ToLower();
+
+		if (!symbol.parent.IsEmpty())
+			return label + " " + symbol.parent + "." + symbol.name;
+
+		return label + " " + symbol.name;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void SendChunk(AIBatchFile file, AIBatchChunk chunk)
+	{
+		chunk.isPending = true;
+		chunk.callback = new AIBatchChunkCallback(this, file, chunk);
+		m_InFlight++;
+		m_ChunksSent++;
+
+		// A request that cannot be sent reports its error before this returns
+		chunk.request = m_Core.ProcessBatchRequest(m_Type, m_Instructions, file.path, chunk.text, file.header, chunk.callback);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Provider-reported tokens when available, the local estimate otherwise
+	protected static int CountTokens(AIRequest request, string response)
+	{
+		if (!request)
+			return AITokenEstimator.Estimate(response);
+
+		if (request.inputTokens >= 0 && request.outputTokens >= 0)
+			return request.inputTokens + request.outputTokens;
+
+		return Math.Max(0, request.estimatedInputTokens) + AITokenEstimator.Estimate(response);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Write the report next to the source, e.g. Scripts/Game/Foo.c.doc.md
+	protected void FinishFile(AIBatchFile file)
+	{
+		array<string> pieces = {};
+		pieces.Insert("# " + GetTypeLabel() + ": " + file.path + "\n\n");
+
+		foreach (AIBatchChunk chunk : file.chunks)
+		{
+			pieces.Insert("## " + chunk.label + "\n\n");
+			pieces.Insert(chunk.result);
+			pieces.Insert("\n\n");
+		}
+
+		if (!AIFileUtils.WriteAll(file.path + GetReportSuffix(), AIJSONUtils.JoinStrings(pieces)))
+			Print("[AI Copilot] Batch could not write the report for " + file.path, LogLevel.WARNING);
+
+		// Only the text of open files is needed; finished ones keep their results until pruned
+		file.text = "";
+		file.header = "";
+		m_FilesDone++;
+		if (file.isResumed)
+			m_FilesResumed++;
+		else
+			Print("[AI Copilot] Batch: " + GetStatusText());
+	}
+
+	//-----------------------------------------------------------------------------
+	protected string GetReportSuffix()
+	{
+		if (m_Type == AIRequestType.CODE_ANALYSIS)
+			return ".analysis.md";
+
+		return ".doc.md";
+	}
+
+	//-----------------------------------------------------------------------------
+	protected string GetTypeLabel()
+	{
+		if (m_Type == AIRequestType.CODE_ANALYSIS)
+			return "Analysis";
+
+		return "Documentation";
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Checkpoint header identifying the job; a different job starts a new file
+	protected string BuildCheckpointHeader()
+	{
+		return string.Format("{\"version\": %1, \"type\": %2, \"root\": \"%3\", \"instructions\": %4}\n", CHECKPOINT_VERSION, m_Type, AIJSONUtils.EscapeString(m_Root), m_Instructions.Hash());
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Read completed chunks of the same job; anything else is discarded
+	protected void LoadCheckpoint()
+	{
+		m_Completed.Clear();
+
+		string content;
+		if (AIFileUtils.ReadAll(m_CheckpointPath, content))
+		{
+			array<string> lines = {};
+			content.Split("\n", lines, true);
+
+			if (!lines.IsEmpty() && lines[0] + "\n" == BuildCheckpointHeader())
+			{
+				string parseError;
+				for (int i = 1; i < lines.Count(); i++)
+				{
+					// A line cut short by a crash fails to parse and is skipped
+					AIJSONValue record = AIJSONReader.Parse(lines[i], parseError);
+					if (record && record.IsObject() && record.Has("key"))
+						m_Completed.Set(record.GetString("key"), record.GetString("result"));
+				}
+
+				return;
+			}
+		}
+
+		AIFileUtils.WriteAll(m_CheckpointPath, BuildCheckpointHeader());
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void AppendCheckpoint(AIBatchChunk chunk)
+	{
+		FileHandle file = FileIO.OpenFile(m_CheckpointPath, FileMode.APPEND);
+		if (!file)
+			return;
+
+		file.Write("{\"key\": \"" + AIJSONUtils.EscapeString(chunk.key) + "\", \"result\": \"" + AIJSONUtils.EscapeString(chunk.result) + "\"}\n");
+		file.Close();
+	}
+
+	//-----------------------------------------------------------------------------
+	bool IsRunning() { return m_IsRunning; }
+	int GetFileCount() { return m_Paths.Count(); }
+	int GetFilesDone() { return m_FilesDone; }
+
+	//-----------------------------------------------------------------------------
+	protected int GetElapsedMs()
+	{
+		if (m_IsRunning)
+			return System.GetTickCount() - m_StartTick;
+
+		return m_EndTick - m_StartTick;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Files sent this run per minute; files answered from the checkpoint do not count
+	float GetFilesPerMinute()
+	{
+		int elapsedMs = GetElapsedMs();
+		if (elapsedMs <= 0)
+			return 0;
+
+		return (m_FilesDone - m_FilesResumed) * 60000.0 / elapsedMs;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Input plus output tokens per second for the chunks sent this run
+	float GetTokensPerSecond()
+	{
+		int elapsedMs = GetElapsedMs();
+		if (elapsedMs <= 0)
+			return 0;
+
+		return m_Tokens * 1000.0 / elapsedMs;
+	}
+
+	//-----------------------------------------------------------------------------
+	string GetStatusText()
+	{
+		return string.Format("%1/%2 files (%3 from checkpoint), %4 chunks sent, %5 failed, %6 files/min, %7 tokens/s", m_FilesDone, m_Paths.Count(), m_FilesResumed, m_ChunksSent, m_ChunksFailed, GetFilesPerMinute().ToString(-1, 1), GetTokensPerSecond().ToString(-1, 1));
+	}
+}
@@ -0,0 +1,947 @@
+//-----------------------------------------------------------------------------
+//! Symbol index of the project's scripts for retrieval-augmented prompts
+//! Classes, enums and methods are extracted by a lightweight brace-aware scanner
+//! and kept in an inverted index of their name tokens. Only files whose
+//! fingerprint changed are scanned again, and the index survives restarts.
+//-----------------------------------------------------------------------------
+
+enum AICodeSymbolKind
+{
+	CLASS,
+	ENUM,
+	METHOD
+}
+
+//-----------------------------------------------------------------------------
+//! A definition in a script file; start and length locate its full text
+class AICodeSymbol
+{
+	int id;
+	AICodeSymbolKind kind;
+	string name;
+	//! Class a method belongs to, empty for global functions
+	string parent;
+	//! Base class of a class or enum
+	string baseName;
+	string path;
+	int start;
+	int length;
+
+	//-----------------------------------------------------------------------------
+	//! Short label such as "method SCR_Foo.OnPostInit" for prompt headers
+	string Describe()
+	{
+		string label = EnumToString(typeof(AICodeSymbolKind), kind);
+		label.ToLower();
+
+		if (!parent.IsEmpty())
+			label += " " + parent + "." + name;
+		else
+			label += " " + name;
+
+		if (!baseName.IsEmpty())
+			label += " : " + baseName;
+
+		return label + " (" + path + ")";
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Indexed state of one script file
+class AICodeIndexFile
+{
+	string path;
+	int size;
+	int fingerprint;
+	//! Hash of the whole text; catches same-size edits between the fingerprint blocks
+	int contentHash;
+	ref array<int> symbolIds;
+	//! Set when the file was found by the latest refresh; unseen files were deleted
+	bool seen;
+
+	void AICodeIndexFile()
+	{
+		symbolIds = {};
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Extracts class, enum and method definitions from Enforce Script source
+//! Comments, strings and preprocessor lines are skipped; the text before each
+//! opening brace is classified by keyword and nesting depth.
+class AICodeScanner
+{
+	protected static const string IDENTIFIER_CHARACTERS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+	protected static const string WHITESPACE_CHARACTERS = " \t\r\n";
+	protected static const ref array<string> CONTROL_KEYWORDS = {"if", "else", "for", "foreach", "while", "switch", "return", "new", "delete", "do"};
+
+	//-----------------------------------------------------------------------------
+	static void Scan(string text, string path, array<ref AICodeSymbol> symbols)
+	{
+		int length = text.Length();
+		int headerStart = -1;
+		// Braces inside parentheses are initializers, e.g. in attribute arguments
+		int parenDepth = 0;
+		// Symbol opened by each brace still open, null for plain blocks
+		array<AICodeSymbol> openSymbols = {};
+
+		int i = 0;
+		while (i < length)
+		{
+			string ch = text.Get(i);
+
+			if (ch == "/" && i + 1 < length)
+			{
+				string next = text.Get(i + 1);
+				if (next == "/")
+				{
+					int lineEnd = text.IndexOfFrom(i, "\n");
+					if (lineEnd == -1)
+						break;
+
+					i = lineEnd + 1;
+					continue;
+				}
+
+				if (next == "*")
+				{
+					int commentEnd = text.IndexOfFrom(i + 2, "*/");
+					if (commentEnd == -1)
+						break;
+
+					i = commentEnd + 2;
+					continue;
+				}
+			}
+
+			if (ch == "#" && headerStart == -1)
+			{
+				int directiveEnd = text.IndexOfFrom(i, "\n");
+				if (directiveEnd == -1)
+					break;
+
+				i = directiveEnd + 1;
+				continue;
+			}
+
+			if (ch == "\"" || ch == "'")
+			{
+				if (headerStart == -1)
+					headerStart = i;
+
+				i = SkipString(text, i, ch);
+				continue;
+			}
+
+			if (ch == "(")
+			{
+				parenDepth++;
+			}
+			else if (ch == ")")
+			{
+				parenDepth = Math.Max(0, parenDepth - 1);
+			}
+
+			if (parenDepth > 0)
+			{
+				if (headerStart == -1)
+					headerStart = i;
+			}
+			else if (ch == "{")
+			{
+				AICodeSymbol symbol = null;
+				if (headerStart != -1)
+					symbol = ClassifyHeader(text.Substring(headerStart, i - headerStart), openSymbols, path, headerStart);
+
+				if (symbol)
+					symbols.Insert(symbol);
+
+				openSymbols.Insert(symbol);
+				headerStart = -1;
+			}
+			else if (ch == "}")
+			{
+				int top = openSymbols.Count() - 1;
+				if (top >= 0)
+				{
+					AICodeSymbol closed = openSymbols[top];
+					if (closed)
+						closed.length = i + 1 - closed.start;
+
+					openSymbols.Remove(top);
+				}
+
+				headerStart = -1;
+			}
+			else if (ch == ";")
+			{
+				headerStart = -1;
+			}
+			else if (headerStart == -1 && !WHITESPACE_CHARACTERS.Contains(ch))
+			{
+				headerStart = i;
+			}
+
+			i++;
+		}
+
+		// Unterminated definitions run to the end of the file
+		foreach (AICodeSymbol unclosed : openSymbols)
+		{
+			if (unclosed)
+				unclosed.length = length - unclosed.start;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Position just past the string literal starting at start
+	protected static int SkipString(string text, int start, string quote)
+	{
+		int length = text.Length();
+		int i = start + 1;
+		while (i < length)
+		{
+			string ch = text.Get(i);
+			if (ch == "\\")
+				i += 2;
+			else if (ch == quote)
+				return i + 1;
+			else
+				i++;
+		}
+
+		return length;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Symbol declared by the text in front of an opening brace, if any
+	protected static AICodeSymbol ClassifyHeader(string header, array<AICodeSymbol> openSymbols, string path, int start)
+	{
+		int depth = openSymbols.Count();
+		array<string> words = {};
+
+		if (depth == 0)
+		{
+			AICodeSymbolKind kind = AICodeSymbolKind.CLASS;
+			string declaration = DeclarationAfter(header, "class");
+			if (declaration.IsEmpty())
+			{
+				kind = AICodeSymbolKind.ENUM;
+				declaration = DeclarationAfter(header, "enum");
+			}
+
+			if (!declaration.IsEmpty())
+			{
+				SplitWords(declaration, words);
+				if (words.IsEmpty())
+					return null;
+
+				AICodeSymbol type = NewSymbol(kind, words[0], path, start);
+				if (words.Count() > 2 && words[1] == "extends")
+					type.baseName = words[2];
+				else if (words.Count() > 1 && declaration.Contains(":"))
+					type.baseName = words[1];
+
+				return type;
+			}
+		}
+
+		// Methods of a class, or global functions
+		string parent;
+		if (depth == 1)
+		{
+			AICodeSymbol owner = openSymbols[0];
+			if (!owner || owner.kind != AICodeSymbolKind.CLASS)
+				return null;
+
+			parent = owner.name;
+		}
+		else if (depth > 1)
+		{
+			return null;
+		}
+
+		string declaration = StripAttributes(header);
+		int paren = declaration.IndexOf("(");
+		if (paren <= 0)
+			return null;
+
+		string signature = declaration.Substring(0, paren);
+		if (signature.Contains("="))
+			return null;
+
+		SplitWords(signature, words);
+		if (words.Count() < 2 || CONTROL_KEYWORDS.Contains(words[0]))
+			return null;
+
+		string name = words[words.Count() - 1];
+		if (CONTROL_KEYWORDS.Contains(name))
+			return null;
+
+		AICodeSymbol method = NewSymbol(AICodeSymbolKind.METHOD, name, path, start);
+		method.parent = parent;
+		return method;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Header without leading attributes such as [Attribute("1")]
+	protected static string StripAttributes(string header)
+	{
+		int length = header.Length();
+		int position = 0;
+		while (position < length)
+		{
+			string ch = header.Get(position);
+			if (WHITESPACE_CHARACTERS.Contains(ch))
+			{
+				position++;
+				continue;
+			}
+
+			if (ch != "[")
+				break;
+
+			int depth = 0;
+			while (position < length)
+			{
+				ch = header.Get(position);
+				if (ch == "\"" || ch == "'")
+				{
+					position = SkipString(header, position, ch);
+					continue;
+				}
+
+				position++;
+				if (ch == "[")
+				{
+					depth++;
+				}
+				else if (ch == "]")
+				{
+					depth--;
+					if (depth == 0)
+						break;
+				}
+			}
+		}
+
+		return header.Substring(position, length - position);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Text after the last whole-word occurrence of keyword, or "" if absent
+	protected static string DeclarationAfter(string header, string keyword)
+	{
+		int position = header.LastIndexOf(keyword + " ");
+		if (position == -1)
+			return "";
+
+		if (position > 0 && !(WHITESPACE_CHARACTERS + "]").Contains(header.Get(position - 1)))
+			return "";
+
+		int declarationStart = position + keyword.Length() + 1;
+		return header.Substring(declarationStart, header.Length() - declarationStart);
+	}
+
+	//-----------------------------------------------------------------------------
+	protected static AICodeSymbol NewSymbol(AICodeSymbolKind kind, string name, string path, int start)
+	{
+		AICodeSymbol symbol = new AICodeSymbol();
+		symbol.kind = kind;
+		symbol.name = name;
+		symbol.path = path;
+		symbol.start = start;
+		return symbol;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Split text into identifiers
+	static void SplitWords(string text, array<string> words)
+	{
+		int length = text.Length();
+		int start = -1;
+		for (int i = 0; i <= length; i++)
+		{
+			bool isWord = i < length && IDENTIFIER_CHARACTERS.Contains(text.Get(i));
+			if (isWord && start == -1)
+			{
+				start = i;
+			}
+			else if (!isWord && start != -1)
+			{
+				words.Insert(text.Substring(start, i - start));
+				start = -1;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Persisted inverted index over the symbols of every script under a root
+//! Refresh() enumerates the files and queues the ones whose size or content
+//! fingerprint changed; IndexPending() scans queued files within a time budget
+//! so large projects are indexed across several calls instead of stalling the
+//! editor. The fingerprint only covers the first and last blocks, so files it
+//! cannot tell apart are re-hashed in full in the background, one pass at a
+//! time. Full identifiers and their camel-case parts are indexed separately so
+//! exact name matches rank above partial ones.
+class AICodeIndex
+{
+	protected static const int STORE_VERSION = 2;
+	protected static const int MIN_TOKEN_LENGTH = 3;
+	protected static const int FINGERPRINT_BLOCK = 4096;
+	protected static const int NAME_MATCH_WEIGHT = 8;
+	protected static const int PART_MATCH_WEIGHT = 1;
+	protected static const string UPPER_CHARACTERS = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+	protected string m_Root;
+	protected string m_StorePath;
+	protected ref map<string, ref AICodeIndexFile> m_Files;
+	protected ref map<int, ref AICodeSymbol> m_Symbols;
+	protected ref map<string, ref array<int>> m_NamePostings;
+	protected ref map<string, ref array<int>> m_PartPostings;
+	protected ref array<string> m_PendingPaths;
+	//! Unchanged-looking files awaiting a full-content check
+	protected ref array<string> m_VerifyPaths;
+	protected ref array<string> m_FoundPaths;
+	protected int m_NextSymbolId;
+	protected int m_StalePostings;
+	protected bool m_IsStoreDirty;
+	protected int m_LastRefreshMs;
+	protected int m_LastScanCount;
+
+	//-----------------------------------------------------------------------------
+	void AICodeIndex(string root, string storePath)
+	{
+		m_Root = root;
+		m_StorePath = storePath;
+		m_Files = new map<string, ref AICodeIndexFile>();
+		m_Symbols = new map<int, ref AICodeSymbol>();
+		m_NamePostings = new map<string, ref array<int>>();
+		m_PartPostings = new map<string, ref array<int>>();
+		m_PendingPaths = {};
+		m_VerifyPaths = {};
+		m_FoundPaths = {};
+		m_NextSymbolId = 1;
+		m_StalePostings = 0;
+		m_IsStoreDirty = false;
+		m_LastRefreshMs = 0;
+		m_LastScanCount = 0;
+
+		Load();
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Queue new and changed files and forget deleted ones
+	//! Returns the number of files waiting to be scanned
+	int Refresh()
+	{
+		int startTick = System.GetTickCount();
+
+		m_FoundPaths.Clear();
+		FileIO.FindFiles(OnScriptFound, m_Root, ".c");
+
+		foreach (string path, AICodeIndexFile file : m_Files)
+		{
+			file.seen = false;
+		}
+
+		m_PendingPaths.Clear();
+		// A new verification pass starts once the previous one has finished
+		bool startVerification = m_VerifyPaths.IsEmpty();
+		foreach (string foundPath : m_FoundPaths)
+		{
+			AICodeIndexFile known = m_Files.Get(foundPath);
+			if (known)
+				known.seen = true;
+
+			int size;
+			int fingerprint;
+			if (!Fingerprint(foundPath, size, fingerprint))
+				continue;
+
+			if (!known || known.size != size || known.fingerprint != fingerprint)
+				m_PendingPaths.Insert(foundPath);
+			else if (startVerification && size > 2 * FINGERPRINT_BLOCK)
+				m_VerifyPaths.Insert(foundPath);
+		}
+
+		array<string> deleted = {};
+		foreach (string indexedPath, AICodeIndexFile indexed : m_Files)
+		{
+			if (!indexed.seen)
+				deleted.Insert(indexedPath);
+		}
+
+		foreach (string deletedPath : deleted)
+		{
+			RemoveFile(deletedPath);
+		}
+
+		m_LastRefreshMs = System.GetTickCount() - startTick;
+		return m_PendingPaths.Count();
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void OnScriptFound(string fileName, FileAttribute attributes = 0, string filesystem = string.Empty)
+	{
+		if (fileName.EndsWith(".c"))
+			m_FoundPaths.Insert(fileName);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Scan queued files, then verify unchanged-looking ones, until budgetMs has
+	//! passed; true when both queues are empty
+	bool IndexPending(int budgetMs)
+	{
+		int startTick = System.GetTickCount();
+		m_LastScanCount = 0;
+
+		while (!m_PendingPaths.IsEmpty())
+		{
+			string path = m_PendingPaths[m_PendingPaths.Count() - 1];
+			m_PendingPaths.Remove(m_PendingPaths.Count() - 1);
+
+			IndexFile(path);
+			m_LastScanCount++;
+
+			if (System.GetTickCount() - startTick >= budgetMs)
+				break;
+		}
+
+		while (m_PendingPaths.IsEmpty() && !m_VerifyPaths.IsEmpty() && System.GetTickCount() - startTick < budgetMs)
+		{
+			string verifyPath = m_VerifyPaths[m_VerifyPaths.Count() - 1];
+			m_VerifyPaths.Remove(m_VerifyPaths.Count() - 1);
+
+			if (VerifyFile(verifyPath))
+				m_LastScanCount++;
+		}
+
+		bool isIdle = m_PendingPaths.IsEmpty() && m_VerifyPaths.IsEmpty();
+		if (isIdle && m_IsStoreDirty)
+			Save();
+
+		return isIdle;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Cheap change check: the size plus a hash of the first and last blocks
+	protected bool Fingerprint(string path, out int size, out int fingerprint)
+	{
+		FileHandle handle = FileIO.OpenFile(path, FileMode.READ);
+		if (!handle)
+			return false;
+
+		size = handle.GetLength();
+
+		string head;
+		handle.Read(head, Math.Min(size, FINGERPRINT_BLOCK));
+
+		string tail;
+		int tailLength = TailLength(size);
+		if (tailLength > 0)
+		{
+			handle.Seek(size - tailLength);
+			handle.Read(tail, tailLength);
+		}
+
+		handle.Close();
+
+		fingerprint = (size.ToString() + ":" + head + tail).Hash();
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Same fingerprint as above, for content already in memory
+	protected static int FingerprintText(string text)
+	{
+		int size = text.Length();
+		int tailLength = TailLength(size);
+		string head = text.Substring(0, Math.Min(size, FINGERPRINT_BLOCK));
+		string tail = text.Substring(size - tailLength, tailLength);
+		return (size.ToString() + ":" + head + tail).Hash();
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Bytes in the tail block, which never overlaps the head block
+	protected static int TailLength(int size)
+	{
+		return Math.Max(0, Math.Min(size - FINGERPRINT_BLOCK, FINGERPRINT_BLOCK));
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void IndexFile(string path)
+	{
+		RemoveFile(path);
+
+		string text;
+		if (!AIFileUtils.ReadAll(path, text))
+			return;
+
+		IndexText(path, text);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Re-index a file whose full text no longer matches its stored hash
+	//! Returns true when the file had changed
+	protected bool VerifyFile(string path)
+	{
+		AICodeIndexFile known = m_Files.Get(path);
+		if (!known)
+			return false;
+
+		string text;
+		if (!AIFileUtils.ReadAll(path, text) || text.Hash() == known.contentHash)
+			return false;
+
+		RemoveFile(path);
+		IndexText(path, text);
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void IndexText(string path, string text)
+	{
+		AICodeIndexFile file = new AICodeIndexFile();
+		file.path = path;
+		file.seen = true;
+		file.size = text.Length();
+		file.fingerprint = FingerprintText(text);
+		file.contentHash = text.Hash();
+
+		array<ref AICodeSymbol> symbols = {};
+		AICodeScanner.Scan(text, path, symbols);
+
+		foreach (AICodeSymbol symbol : symbols)
+		{
+			AddSymbol(file, symbol);
+		}
+
+		m_Files.Set(path, file);
+		m_IsStoreDirty = true;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void AddSymbol(AICodeIndexFile file, AICodeSymbol symbol)
+	{
+		symbol.id = m_NextSymbolId;
+		m_NextSymbolId++;
+
+		m_Symbols.Set(symbol.id, symbol);
+		file.symbolIds.Insert(symbol.id);
+		AddPostings(symbol);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Index the full name, its parts and, for types, the base class name
+	protected void AddPostings(AICodeSymbol symbol)
+	{
+		string lower = symbol.name;
+		lower.ToLower();
+		AddPosting(m_NamePostings, lower, symbol.id);
+
+		array<string> parts = {};
+		SplitIdentifier(symbol.name, parts);
+		if (!symbol.baseName.IsEmpty())
+		{
+			string baseLower = symbol.baseName;
+			baseLower.ToLower();
+			parts.Insert(baseLower);
+		}
+
+		foreach (string part : parts)
+		{
+			AddPosting(m_PartPostings, part, symbol.id);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void AddPosting(map<string, ref array<int>> postings, string token, int symbolId)
+	{
+		array<int> ids = postings.Get(token);
+		if (!ids)
+		{
+			ids = {};
+			postings.Set(token, ids);
+		}
+
+		if (ids.IsEmpty() || ids[ids.Count() - 1] != symbolId)
+			ids.Insert(symbolId);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Drop a file's symbols; their postings are skipped until the next compaction
+	protected void RemoveFile(string path)
+	{
+		AICodeIndexFile file = m_Files.Get(path);
+		if (!file)
+			return;
+
+		foreach (int symbolId : file.symbolIds)
+		{
+			m_Symbols.Remove(symbolId);
+			m_StalePostings++;
+		}
+
+		m_Files.Remove(path);
+		m_IsStoreDirty = true;
+
+		if (m_StalePostings > m_Symbols.Count())
+			RebuildPostings();
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void RebuildPostings()
+	{
+		m_NamePostings.Clear();
+		m_PartPostings.Clear();
+		m_StalePostings = 0;
+
+		foreach (string path, AICodeIndexFile file : m_Files)
+		{
+			array<int> ids = {};
+			ids.Copy(file.symbolIds);
+			file.symbolIds.Clear();
+
+			foreach (int symbolId : ids)
+			{
+				AICodeSymbol symbol = m_Symbols.Get(symbolId);
+				if (!symbol)
+					continue;
+
+				file.symbolIds.Insert(symbolId);
+				AddPostings(symbol);
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Lower-case camel-case and underscore parts of an identifier
+	//! e.g. SCR_BaseGameMode -> scr, base, game, mode
+	static void SplitIdentifier(string identifier, array<string> parts)
+	{
+		string lower = identifier;
+		lower.ToLower();
+
+		int length = identifier.Length();
+		int start = 0;
+		for (int i = 1; i <= length; i++)
+		{
+			bool boundary = i == length;
+			if (!boundary)
+			{
+				string ch = identifier.Get(i);
+				boundary = ch == "_" || (UPPER_CHARACTERS.Contains(ch) && !UPPER_CHARACTERS.Contains(identifier.Get(i - 1)));
+			}
+
+			if (!boundary)
+				continue;
+
+			string part = lower.Substring(start, i - start);
+			part.Replace("_", "");
+			if (part.Length() >= MIN_TOKEN_LENGTH && part != lower && !parts.Contains(part))
+				parts.Insert(part);
+
+			start = i;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//! The topK symbols most relevant to the identifiers and words in query
+	//! Symbols defined in excludePath (typically the open script) are skipped
+	array<AICodeSymbol> Search(string query, int topK, string excludePath = "")
+	{
+		array<string> words = {};
+		AICodeScanner.SplitWords(query, words);
+
+		set<string> names = new set<string>();
+		set<string> parts = new set<string>();
+		foreach (string word : words)
+		{
+			string lower = word;
+			lower.ToLower();
+			if (lower.Length() >= MIN_TOKEN_LENGTH)
+			{
+				names.Insert(lower);
+				parts.Insert(lower);
+			}
+
+			array<string> wordParts = {};
+			SplitIdentifier(word, wordParts);
+			foreach (string wordPart : wordParts)
+			{
+				parts.Insert(wordPart);
+			}
+		}
+
+		map<int, int> scores = new map<int, int>();
+		foreach (string name : names)
+		{
+			AccumulateScores(m_NamePostings.Get(name), NAME_MATCH_WEIGHT, scores);
+		}
+
+		foreach (string part : parts)
+		{
+			AccumulateScores(m_PartPostings.Get(part), PART_MATCH_WEIGHT, scores);
+		}
+
+		array<AICodeSymbol> results = {};
+		array<int> resultScores = {};
+		foreach (int symbolId, int score : scores)
+		{
+			AICodeSymbol symbol = m_Symbols.Get(symbolId);
+			if (!symbol || symbol.path == excludePath)
+				continue;
+
+			// Keep the best topK in descending order
+			int index = results.Count();
+			while (index > 0 && resultScores[index - 1] < score)
+			{
+				index--;
+			}
+
+			if (index >= topK)
+				continue;
+
+			results.InsertAt(symbol, index);
+			resultScores.InsertAt(score, index);
+
+			if (results.Count() > topK)
+			{
+				results.Remove(topK);
+				resultScores.Remove(topK);
+			}
+		}
+
+		return results;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Rare tokens weigh more than tokens shared by many symbols
+	protected void AccumulateScores(array<int> ids, int weight, map<int, int> scores)
+	{
+		if (!ids)
+			return;
+
+		int score = weight * 1000 / (ids.Count() + 2);
+		foreach (int symbolId : ids)
+		{
+			scores.Set(symbolId, scores.Get(symbolId) + score);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Full text of a definition; fileCache avoids re-reading shared files
+	string ReadDefinition(AICodeSymbol symbol, map<string, string> fileCache = null)
+	{
+		string text;
+		if (!fileCache || !fileCache.Find(symbol.path, text))
+		{
+			if (!AIFileUtils.ReadAll(symbol.path, text))
+				return "";
+
+			if (fileCache)
+				fileCache.Set(symbol.path, text);
+		}
+
+		if (symbol.start < 0 || symbol.start + symbol.length > text.Length())
+			return "";
+
+		return text.Substring(symbol.start, symbol.length);
+	}
+
+	//-----------------------------------------------------------------------------
+	string GetRoot() { return m_Root; }
+	int GetFileCount() { return m_Files.Count(); }
+	int GetSymbolCount() { return m_Symbols.Count(); }
+	int GetPendingCount() { return m_PendingPaths.Count(); }
+	//! Duration of the last Refresh() and number of files scanned by the last IndexPending()
+	int GetLastRefreshMs() { return m_LastRefreshMs; }
+	int GetLastScanCount() { return m_LastScanCount; }
+
+	//-----------------------------------------------------------------------------
+	//! Persist as JSON lines: a header, then one line per file with its symbols
+	//! The index is a cache; a damaged store is simply rebuilt
+	protected void Save()
+	{
+		array<string> pieces = {};
+		pieces.Insert("{\"version\": " + STORE_VERSION + ", \"root\": \"" + AIJSONUtils.EscapeString(m_Root) + "\"}\n");
+
+		foreach (string path, AICodeIndexFile file : m_Files)
+		{
+			pieces.Insert("{\"path\": \"" + AIJSONUtils.EscapeString(path) + "\", \"size\": " + file.size + ", \"fingerprint\": " + file.fingerprint + ", \"contentHash\": " + file.contentHash + ", \"symbols\": [");
+
+			for (int i = 0; i < file.symbolIds.Count(); i++)
+			{
+				AICodeSymbol symbol = m_Symbols.Get(file.symbolIds[i]);
+				if (!symbol)
+					continue;
+
+				string separator = "";
+				if (i > 0)
+					separator = ", ";
+
+				pieces.Insert(string.Format("%1[%2, \"%3\", \"%4\", \"%5\", %6, %7]", separator, symbol.kind, AIJSONUtils.EscapeString(symbol.name), AIJSONUtils.EscapeString(symbol.parent), AIJSONUtils.EscapeString(symbol.baseName), symbol.start, symbol.length));
+			}
+
+			pieces.Insert("]}\n");
+		}
+
+		if (AIFileUtils.WriteAll(m_StorePath, AIJSONUtils.JoinStrings(pieces)))
+			m_IsStoreDirty = false;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void Load()
+	{
+		string content;
+		if (!AIFileUtils.ReadAll(m_StorePath, content))
+			return;
+
+		array<string> lines = {};
+		content.Split("\n", lines, true);
+		if (lines.IsEmpty())
+			return;
+
+		string parseError;
+		AIJSONValue header = AIJSONReader.Parse(lines[0], parseError);
+		if (!header || !header.IsObject() || header.GetInt("version") != STORE_VERSION || header.GetString("root") != m_Root)
+			return;
+
+		for (int i = 1; i < lines.Count(); i++)
+		{
+			AIJSONValue record = AIJSONReader.Parse(lines[i], parseError);
+			if (!record || !record.IsObject())
+				continue;
+
+			AIJSONValue symbols = record.Get("symbols");
+			if (!symbols || !symbols.IsArray())
+				continue;
+
+			AICodeIndexFile file = new AICodeIndexFile();
+			file.path = record.GetString("path");
+			file.size = record.GetInt("size");
+			file.fingerprint = record.GetInt("fingerprint");
+			file.contentHash = record.GetInt("contentHash");
+
+			foreach (AIJSONValue element : symbols.elements)
+			{
+				if (!element.IsArray() || element.elements.Count() != 6)
+					continue;
+
+				AICodeSymbol symbol = new AICodeSymbol();
+				symbol.kind = element.elements[0].AsInt();
+				symbol.name = element.elements[1].AsString();
+				symbol.parent = element.elements[2].AsString();
+				symbol.baseName = element.elements[3].AsString();
+				symbol.path = file.path;
+				symbol.start = element.elements[4].AsInt();
+				symbol.length = element.elements[5].AsInt();
+				AddSymbol(file, symbol);
+			}
+
+			m_Files.Set(file.path, file);
+		}
+	}
+}
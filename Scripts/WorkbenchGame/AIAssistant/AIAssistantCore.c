@@ -17,53 +17,203 @@ OPTIMIZATION,
 
 class AIAssistantCore
 {
+	//! How often the script index looks for changed files
+	protected static const int CODE_INDEX_REFRESH_MS = 10000;
+	//! Indexing allowed while a prompt waits; the rest continues in the background
+	protected static const int CODE_INDEX_PROMPT_BUDGET_MS = 250;
+	protected static const int CODE_INDEX_SLICE_MS = 30;
+	protected static const int CODE_INDEX_SLICE_INTERVAL_MS = 100;
+	//! Longest related definition added to a prompt
+	protected static const int MAX_DEFINITION_CHARS = 4000;
+	//! Longest file header sent along with a batch chunk
+	protected static const int MAX_BATCH_HEADER_CHARS = 2000;
+	//! Opens every system prompt; identical across requests so providers can cache it
+	protected static const string SYSTEM_PREAMBLE = "You are an AI copilot embedded in the Arma Reforger Workbench.\nAssist with scripting, configuration and tooling questions.\n";
+	//! Queue priorities; higher starts first, here and in the bridge's queues
+	static const int PRIORITY_BATCH = 0;
+	static const int PRIORITY_NORMAL = 1;
+	static const int PRIORITY_INTERACTIVE = 2;
+	//! Error reported to the callbacks of a cancelled request
+	static const string REQUEST_CANCELLED = "Request cancelled";
+	//! Completed batch chunks, so an interrupted job resumes where it stopped
+	protected static const string BATCH_CHECKPOINT_PATH = "$profile:AIAssistantBatch.jsonl";
+	//! Provider batches complete within 24 hours; the extra hour covers collection and polling
+	protected static const int PROVIDER_BATCH_TIMEOUT_MS = 90000000;
+	//! Chunks a batch job hands to the bridge at once when it uses provider batches
+	protected static const int PROVIDER_BATCH_CHUNKS = 500;
+	
 	protected ref AIAssistantSettings m_Settings;
-	protected ref array<ref AIRequest> m_RequestHistory;
-protected bool m_IsProcessing;
-protected AIServiceCallback m_PendingServiceCallback;
-protected AIRequest m_ActiveRequest;
-protected int m_RequestStartTick;
-protected int m_ResponseTimeoutMs;
-protected int m_PollIntervalMs;
+	protected ref AIRequestHistory m_History;
+	protected ref AICodeIndex m_CodeIndex;
+	protected ref AIBatchJob m_BatchJob;
+	protected int m_LastCodeIndexRefreshTick;
+	protected bool m_IsCodeIndexScheduled;
+	protected ref map<string, ref AIPendingRequest> m_ActiveRequests;
+	//! Active requests waiting on a provider batch; they do not count against the concurrency limit
+	protected int m_ProviderBatchRequests;
+	protected ref array<ref AIPendingRequest> m_QueuedRequests;
+	//! Active or queued request per dedupe key; identical submissions join it
+	protected ref map<string, AIPendingRequest> m_InFlightByKey;
+	protected int m_DedupedRequests;
+	protected bool m_IsPolling;
+	protected int m_RequestCounter;
+	protected int m_ResponseTimeoutMs;
+	protected int m_MinPollIntervalMs;
+	protected int m_MaxPollIntervalMs;
+	protected int m_CurrentPollIntervalMs;
+	protected int m_LastPollTick;
+	protected string m_LastBridgeSequence;
 	
 	//-----------------------------------------------------------------------------
-void AIAssistantCore(AIAssistantSettings settings)
-{
-m_Settings = settings;
-m_RequestHistory = {};
-m_IsProcessing = false;
-m_PendingServiceCallback = null;
-m_ActiveRequest = null;
-m_RequestStartTick = 0;
-m_ResponseTimeoutMs = 60000;
-m_PollIntervalMs = 500;
-}
+	void AIAssistantCore(AIAssistantSettings settings)
+	{
+		m_Settings = settings;
+		m_History = new AIRequestHistory("$profile:AIAssistantHistory", GetHistoryCapacity(), m_Settings.GetSaveRequestHistory());
+		m_ActiveRequests = new map<string, ref AIPendingRequest>();
+		m_ProviderBatchRequests = 0;
+		m_QueuedRequests = {};
+		m_InFlightByKey = new map<string, AIPendingRequest>();
+		m_DedupedRequests = 0;
+		m_IsPolling = false;
+		m_RequestCounter = 0;
+		m_MinPollIntervalMs = 50;
+		m_LastPollTick = 0;
+		m_LastBridgeSequence = "";
+		
+		ApplyTimingSettings();
+		m_CurrentPollIntervalMs = m_MinPollIntervalMs;
+		
+		m_IsCodeIndexScheduled = false;
+		ApplyCodeIndexSettings();
+		
+		// Settings push changes instead of being re-read on every request
+		m_Settings.GetOnSettingChanged().Insert(OnSettingChanged);
+	}
 	
 	//-----------------------------------------------------------------------------
-	//! Process AI request with context
-	void ProcessRequest(AIRequestType requestType, string userInput, WorkbenchContext context, AIResponseCallback callback)
+	void ~AIAssistantCore()
+	{
+		if (m_Settings)
+			m_Settings.GetOnSettingChanged().Remove(OnSettingChanged);
+		
+		if (m_IsCodeIndexScheduled)
+			GetGame().GetCallqueue().Remove(ContinueCodeIndexing);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! React to a settings change; an empty key means everything may have changed
+	protected void OnSettingChanged(string key)
+	{
+		bool all = key.IsEmpty();
+		
+		if (all || key == "response_timeout_ms" || key == "max_poll_interval_ms")
+			ApplyTimingSettings();
+		
+		if (all || key == "save_request_history" || key == "max_history_entries")
+		{
+			m_History.SetPersist(m_Settings.GetSaveRequestHistory());
+			m_History.SetCapacity(GetHistoryCapacity());
+		}
+		
+		if (all || key == "code_index_enabled" || key == "code_index_root")
+			ApplyCodeIndexSettings();
+		
+		// A higher limit can start queued requests right away
+		if (all || key == "max_concurrent_requests")
+			StartQueuedRequests();
+	}
+	
+	//-----------------------------------------------------------------------------
+	protected void ApplyTimingSettings()
+	{
+		m_ResponseTimeoutMs = m_Settings.GetResponseTimeoutMs();
+		m_MaxPollIntervalMs = Math.Max(m_MinPollIntervalMs, m_Settings.GetMaxPollIntervalMs());
+		m_CurrentPollIntervalMs = Math.Min(m_CurrentPollIntervalMs, m_MaxPollIntervalMs);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Create, replace or drop the script index to match the settings
+	protected void ApplyCodeIndexSettings()
 	{
-		if (m_IsProcessing)
+		if (!m_Settings.GetCodeIndexEnabled())
 		{
-			callback.OnError("AI Assistant is currently processing another request. Please wait...");
+			m_CodeIndex = null;
+			return;
+		}
+		
+		if (m_CodeIndex && m_CodeIndex.GetRoot() == m_Settings.GetCodeIndexRoot())
+			return;
+		
+		m_CodeIndex = new AICodeIndex(m_Settings.GetCodeIndexRoot(), "$profile:AIAssistantCodeIndex.jsonl");
+		m_LastCodeIndexRefreshTick = 0;
+		
+		// Warm the index in the background so the first prompt does not wait
+		UpdateCodeIndex(0);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Pick up changed scripts, indexing for at most budgetMs right now
+	protected void UpdateCodeIndex(int budgetMs)
+	{
+		if (!m_CodeIndex)
 			return;
+		
+		int now = System.GetTickCount();
+		if (m_LastCodeIndexRefreshTick == 0 || now - m_LastCodeIndexRefreshTick >= CODE_INDEX_REFRESH_MS)
+		{
+			m_CodeIndex.Refresh();
+			m_LastCodeIndexRefreshTick = Math.Max(1, now);
 		}
 		
-		m_IsProcessing = true;
+		if (!m_CodeIndex.IndexPending(budgetMs))
+			ScheduleCodeIndexing();
+	}
+	
+	//-----------------------------------------------------------------------------
+	protected void ScheduleCodeIndexing()
+	{
+		if (m_IsCodeIndexScheduled)
+			return;
+		
+		m_IsCodeIndexScheduled = true;
+		GetGame().GetCallqueue().CallLater(ContinueCodeIndexing, CODE_INDEX_SLICE_INTERVAL_MS, false);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Index queued scripts in short slices until the queue is empty
+	protected void ContinueCodeIndexing()
+	{
+		m_IsCodeIndexScheduled = false;
+		if (!m_CodeIndex)
+			return;
+		
+		if (!m_CodeIndex.IndexPending(CODE_INDEX_SLICE_MS))
+		{
+			ScheduleCodeIndexing();
+			return;
+		}
 		
+		Print(string.Format("[AI Copilot] Script index ready: %1 files, %2 symbols", m_CodeIndex.GetFileCount(), m_CodeIndex.GetSymbolCount()));
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Process AI request with context
+	//! Requests beyond the concurrency limit are queued until a slot frees up.
+	//! The editor state is captured once here; includeSelection controls whether
+	//! the selected code becomes part of the snapshot.
+	//! Returns the request id, which CancelRequest accepts
+	string ProcessRequest(AIRequestType requestType, string userInput, WorkbenchContext context, AIResponseCallback callback, bool bypassCache = false, bool includeSelection = true)
+	{
 		// Create request object
 		AIRequest request = new AIRequest();
+		request.requestId = GenerateRequestId();
 		request.type = requestType;
+		request.bypassCache = bypassCache;
 		request.userInput = userInput;
-		request.context = context;
+		request.context = CaptureContext(context, includeSelection);
 		request.timestamp = System.GetTickCount();
 		
-// Add to history
-m_RequestHistory.Insert(request);
-ManageHistory(request);
-m_ActiveRequest = request;
-		
-		// Process based on request type
+		// Process based on request type; the request enters the history once it is sent
 switch (requestType)
 {
 case AIRequestType.GENERAL_CHAT:
@@ -100,8 +250,165 @@ break;
 
 default:
 callback.OnError("Unsupported request type");
-m_IsProcessing = false;
 }
+		
+		return request.requestId;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Abandon a request by id
+	//! A queued request never reaches the bridge. A running one is abandoned here
+	//! and a <id>.cancel marker tells the bridge to abort the provider call. A
+	//! request that identical submissions joined keeps running for them.
+	//! Returns false when the request is unknown or already finished.
+	bool CancelRequest(string requestId)
+	{
+		AIPendingRequest pending;
+		foreach (AIPendingRequest queued : m_QueuedRequests)
+		{
+			if (queued.request && queued.request.requestId == requestId)
+			{
+				pending = queued;
+				break;
+			}
+		}
+		
+		if (!pending)
+		{
+			foreach (string activeId, AIPendingRequest active : m_ActiveRequests)
+			{
+				if (active.request && active.request.requestId == requestId)
+				{
+					pending = active;
+					break;
+				}
+			}
+		}
+		
+		if (pending)
+		{
+			if (!pending.followers.IsEmpty())
+			{
+				// The first follower takes over the call and the others stay attached
+				AIPendingRequest heir = pending.followers[0];
+				pending.followers.RemoveOrdered(0);
+				
+				AIRequest cancelledRequest = pending.request;
+				AIServiceCallback cancelledCallback = pending.serviceCallback;
+				pending.request = heir.request;
+				pending.serviceCallback = heir.serviceCallback;
+				heir.request = cancelledRequest;
+				heir.serviceCallback = cancelledCallback;
+				
+				CompleteWithError(heir, REQUEST_CANCELLED);
+			}
+			else if (m_QueuedRequests.Find(pending) != -1)
+			{
+				m_QueuedRequests.RemoveItemOrdered(pending);
+				ForgetInFlight(pending);
+				CompleteWithError(pending, REQUEST_CANCELLED);
+			}
+			else
+			{
+				RemoveActiveRequest(pending);
+				ForgetInFlight(pending);
+				AbandonBridgeRequest(pending);
+				CompleteWithError(pending, REQUEST_CANCELLED);
+				StartQueuedRequests();
+			}
+			
+			Print("[AI Copilot] Request " + requestId + " cancelled");
+			return true;
+		}
+		
+		// A follower leaves its leader without affecting it
+		foreach (AIPendingRequest leader : m_InFlightByKey)
+		{
+			foreach (int followerIndex, AIPendingRequest follower : leader.followers)
+			{
+				if (follower.request && follower.request.requestId == requestId)
+				{
+					pending = follower;
+					leader.followers.RemoveOrdered(followerIndex);
+					CompleteWithError(pending, REQUEST_CANCELLED);
+					Print("[AI Copilot] Request " + requestId + " cancelled");
+					return true;
+				}
+			}
+		}
+		
+		return false;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Send one chunk of a batch job
+	//! Only the chunk and the file header go into the prompt; neither the rest of
+	//! the file nor related definitions, which every chunk of the file would repeat.
+	//! The response is passed on unformatted for the report. Batch requests stay
+	//! out of the history and run at batch priority.
+	AIRequest ProcessBatchRequest(AIRequestType requestType, string instructions, string path, string code, string header, AIResponseCallback callback)
+	{
+		AIRequest request = new AIRequest();
+		request.requestId = GenerateRequestId();
+		request.type = requestType;
+		request.isBatch = true;
+		request.userInput = instructions;
+		request.context = new AIRequestContext("ScriptEditor", path, code, "", 0, 0);
+		request.timestamp = System.GetTickCount();
+		
+		string prompt = BuildBatchPrompt(request, code, header);
+		SendToAIService(request, prompt, new AIBatchCallback(callback));
+		return request;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Document or analyse every script under root; false if a job is already
+	//! running or nothing was found
+	bool StartBatchJob(AIRequestType requestType, string root, string instructions)
+	{
+		if (m_BatchJob && m_BatchJob.IsRunning())
+			return false;
+		
+		// Provider batches are collected in the bridge, so the job hands over far more chunks
+		int parallelism = m_Settings.GetBatchParallelism();
+		if (m_Settings.GetProviderBatchEnabled())
+			parallelism = PROVIDER_BATCH_CHUNKS;
+		
+		m_BatchJob = new AIBatchJob(this, requestType, root, instructions, BATCH_CHECKPOINT_PATH, parallelism);
+		return m_BatchJob.Start();
+	}
+	
+	//-----------------------------------------------------------------------------
+	void StopBatchJob()
+	{
+		if (m_BatchJob)
+			m_BatchJob.Stop();
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! The running or most recent batch job, null if none was started
+	AIBatchJob GetBatchJob()
+	{
+		return m_BatchJob;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Bridge priority of a request type
+	//! Interactive requests are answered ahead of batch-style work such as documentation
+	static int GetRequestPriority(AIRequestType requestType)
+	{
+		switch (requestType)
+		{
+			case AIRequestType.GENERAL_CHAT:
+			case AIRequestType.EXPLANATION:
+			case AIRequestType.CODE_DEBUGGING:
+				return PRIORITY_INTERACTIVE;
+			
+			case AIRequestType.DOCUMENTATION:
+				return PRIORITY_BATCH;
+		}
+		
+		return PRIORITY_NORMAL;
 	}
 	
 	//-----------------------------------------------------------------------------
@@ -111,98 +418,92 @@ m_IsProcessing = false;
 		string prompt = BuildCodeGenerationPrompt(request);
 		
 		// Send to AI service
-		SendToAIService(prompt, new AICodeGenerationCallback(callback));
+		SendToAIService(request, prompt, new AICodeGenerationCallback(callback));
 	}
 	
 	//-----------------------------------------------------------------------------
 	//! Analyze existing code for issues
 protected void ProcessCodeAnalysis(AIRequest request, AIResponseCallback callback)
 	{
-		string codeToAnalyze = GetSelectedCode(request.context);
+		string codeToAnalyze = request.context.GetSelection();
 		if (codeToAnalyze.IsEmpty())
 		{
 			callback.OnError("No code selected for analysis");
-			m_IsProcessing = false;
 			return;
 		}
 		
-		string prompt = BuildCodeAnalysisPrompt(codeToAnalyze, request.userInput);
-		SendToAIService(prompt, new AICodeAnalysisCallback(callback));
+		string prompt = BuildCodeAnalysisPrompt(request, codeToAnalyze);
+		SendToAIService(request, prompt, new AICodeAnalysisCallback(callback));
 	}
 	
 	//-----------------------------------------------------------------------------
 	//! Help debug code issues
 	protected void ProcessDebugging(AIRequest request, AIResponseCallback callback)
 	{
-		string codeContext = GetSelectedCode(request.context);
-		string errorInfo = request.userInput; // User describes the error
+		string codeContext = request.context.GetSelection();
 		
-		string prompt = BuildDebuggingPrompt(codeContext, errorInfo);
-		SendToAIService(prompt, new AIDebuggingCallback(callback));
+		string prompt = BuildDebuggingPrompt(request, codeContext);
+		SendToAIService(request, prompt, new AIDebuggingCallback(callback));
 	}
 	
 	//-----------------------------------------------------------------------------
 	//! Generate documentation
 	protected void ProcessDocumentation(AIRequest request, AIResponseCallback callback)
 	{
-		string codeToDocument = GetSelectedCode(request.context);
+		string codeToDocument = request.context.GetSelection();
 		if (codeToDocument.IsEmpty())
 		{
 			callback.OnError("No code selected for documentation");
-			m_IsProcessing = false;
 			return;
 		}
 		
-		string prompt = BuildDocumentationPrompt(codeToDocument, request.userInput);
-		SendToAIService(prompt, new AIDocumentationCallback(callback));
+		string prompt = BuildDocumentationPrompt(request, codeToDocument);
+		SendToAIService(request, prompt, new AIDocumentationCallback(callback));
 	}
 	
 	//-----------------------------------------------------------------------------
 	//! Suggest optimizations
 	protected void ProcessOptimization(AIRequest request, AIResponseCallback callback)
 	{
-		string codeToOptimize = GetSelectedCode(request.context);
+		string codeToOptimize = request.context.GetSelection();
 		if (codeToOptimize.IsEmpty())
 		{
 			callback.OnError("No code selected for optimization");
-			m_IsProcessing = false;
 			return;
 		}
 		
-		string prompt = BuildOptimizationPrompt(codeToOptimize, request.userInput);
-		SendToAIService(prompt, new AIOptimizationCallback(callback));
+		string prompt = BuildOptimizationPrompt(request, codeToOptimize);
+		SendToAIService(request, prompt, new AIOptimizationCallback(callback));
 	}
 	
 //----------------------------------------------------------------------------- 
 //! Explain code functionality
 protected void ProcessExplanation(AIRequest request, AIResponseCallback callback)
 	{
-		string codeToExplain = GetSelectedCode(request.context);
+		string codeToExplain = request.context.GetSelection();
 		if (codeToExplain.IsEmpty())
 		{
 			callback.OnError("No code selected for explanation");
-			m_IsProcessing = false;
 			return;
 		}
 		
-		string prompt = BuildExplanationPrompt(codeToExplain, request.userInput);
-		SendToAIService(prompt, new AIExplanationCallback(callback));
+		string prompt = BuildExplanationPrompt(request, codeToExplain);
+		SendToAIService(request, prompt, new AIExplanationCallback(callback));
 	}
 	
 //----------------------------------------------------------------------------- 
 //! Refactor code
 protected void ProcessRefactoring(AIRequest request, AIResponseCallback callback)
 {
-string codeToRefactor = GetSelectedCode(request.context);
+string codeToRefactor = request.context.GetSelection();
 if (codeToRefactor.IsEmpty())
 {
 callback.OnError("No code selected for refactoring");
-m_IsProcessing = false;
 return;
 }
 
-string prompt = BuildRefactoringPrompt(codeToRefactor, request.userInput);
-SendToAIService(prompt, new AIRefactoringCallback(callback));
+string prompt = BuildRefactoringPrompt(request, codeToRefactor);
+SendToAIService(request, prompt, new AIRefactoringCallback(callback));
 }
 
 //----------------------------------------------------------------------------- 
@@ -210,14 +511,14 @@ SendToAIService(prompt, new AIRefactoringCallback(callback));
 protected void ProcessGeneralChat(AIRequest request, AIResponseCallback callback)
 {
 string prompt = BuildGeneralChatPrompt(request);
-SendToAIService(prompt, new AIChatCallback(callback));
+SendToAIService(request, prompt, new AIChatCallback(callback));
 }
 	
 	//-----------------------------------------------------------------------------
 	//! Get selected code from context
 string GetSelectedCode(WorkbenchContext context)
 	{
-		if (context.currentModule == "ScriptEditor" && !context.currentScript.IsEmpty())
+		if (context && context.currentModule == "ScriptEditor" && !context.currentScript.IsEmpty())
 		{
 			// Get selected text or entire script
 			return Workbench.ScriptDialog().GetSelectedText();
@@ -227,150 +528,490 @@ string GetSelectedCode(WorkbenchContext context)
 		return "";
 	}
 	
-//----------------------------------------------------------------------------- 
-//! Send request to AI service through the local bridge
-protected void SendToAIService(string prompt, AIServiceCallback serviceCallback)
-{
-if (StartBridgeRequest(prompt, serviceCallback))
-return;
-
-string errorMessage = "Unable to communicate with AI bridge service.";
-FinalizeRequestWithError(errorMessage, serviceCallback);
-}
-
-//----------------------------------------------------------------------------- 
-//! Prepare request file and schedule polling for response
-protected bool StartBridgeRequest(string prompt, AIServiceCallback serviceCallback)
-{
-if (!serviceCallback)
-return false;
-
-string requestJSON = BuildBridgeRequestJSON(prompt);
-if (requestJSON.IsEmpty())
-return false;
-
-CleanupBridgeFiles();
-
-if (!WriteFile(m_Settings.GetRequestFilePath(), requestJSON))
-return false;
-
-m_PendingServiceCallback = serviceCallback;
-m_RequestStartTick = System.GetTickCount();
-ScheduleBridgePoll();
-return true;
-}
-
-//----------------------------------------------------------------------------- 
-//! Schedule another poll for the AI bridge response file
-protected void ScheduleBridgePoll()
-{
-GetGame().GetCallqueue().CallLater(CheckForBridgeResponse, m_PollIntervalMs, false);
-}
-
-//----------------------------------------------------------------------------- 
-//! Check whether the AI bridge wrote the response file
-protected void CheckForBridgeResponse()
-{
-if (!m_PendingServiceCallback)
-return;
-
-string responseContent;
-if (!TryReadFile(m_Settings.GetResponseFilePath(), responseContent))
-{
-if (System.GetTickCount() - m_RequestStartTick >= m_ResponseTimeoutMs)
-{
-HandleBridgeError("Timed out waiting for AI bridge response.");
-}
-else
-{
-ScheduleBridgePoll();
-}
-return;
-}
-
-FileIO.DeleteFile(m_Settings.GetResponseFilePath());
-
-string responseText;
-string errorText;
-if (ParseBridgeResponse(responseContent, responseText, errorText))
-{
-HandleBridgeSuccess(responseText);
-}
-else
-{
-HandleBridgeError(errorText);
-}
-}
-
-//----------------------------------------------------------------------------- 
-//! Handle successful response from bridge service
-protected void HandleBridgeSuccess(string responseText)
-{
-CleanupBridgeFiles();
-
-if (m_ActiveRequest)
-{
-m_ActiveRequest.response = responseText;
-m_ActiveRequest.isCompleted = true;
-m_ActiveRequest.errorMessage = "";
-}
-
-AIServiceCallback callback = m_PendingServiceCallback;
-m_PendingServiceCallback = null;
-m_IsProcessing = false;
-m_ActiveRequest = null;
-
-if (callback)
-callback.OnSuccess(responseText);
-}
-
-//----------------------------------------------------------------------------- 
-//! Handle bridge error
-protected void HandleBridgeError(string errorMessage)
-{
-CleanupBridgeFiles();
-
-if (m_ActiveRequest)
-{
-m_ActiveRequest.isCompleted = true;
-m_ActiveRequest.errorMessage = errorMessage;
-}
-
-AIServiceCallback callback = m_PendingServiceCallback;
-m_PendingServiceCallback = null;
-m_IsProcessing = false;
-m_ActiveRequest = null;
-
-if (callback)
-callback.OnError(errorMessage);
-}
-
-//----------------------------------------------------------------------------- 
-//! Finalize immediately when bridge communication fails before scheduling
-protected void FinalizeRequestWithError(string errorMessage, AIServiceCallback serviceCallback)
-{
-CleanupBridgeFiles();
-
-if (m_ActiveRequest)
-{
-m_ActiveRequest.isCompleted = true;
-m_ActiveRequest.errorMessage = errorMessage;
-}
-
-m_IsProcessing = false;
-m_ActiveRequest = null;
-
-if (serviceCallback)
-serviceCallback.OnError(errorMessage);
-}
-
-//----------------------------------------------------------------------------- 
-//! Remove any leftover request/response files to avoid stale data
-protected void CleanupBridgeFiles()
-{
-DeleteFileIfExists(m_Settings.GetRequestFilePath());
-DeleteFileIfExists(m_Settings.GetResponseFilePath());
-}
+	//-----------------------------------------------------------------------------
+	//! Snapshot the editor state for a request
+	//! The selection and the script are read exactly once per request
+	protected AIRequestContext CaptureContext(WorkbenchContext context, bool includeSelection)
+	{
+		if (!context)
+			return new AIRequestContext("", "", "", "", 0, 0);
+		
+		string selection;
+		if (includeSelection)
+			selection = GetSelectedCode(context);
+		
+		int resourceCount = 0;
+		if (context.selectedResources)
+			resourceCount = context.selectedResources.Count();
+		
+		int entityCount = 0;
+		if (context.selectedEntities)
+			entityCount = context.selectedEntities.Count();
+		
+		return new AIRequestContext(context.currentModule, context.currentScript, selection, ReadCurrentScript(context), resourceCount, entityCount);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Send request to AI service through the local bridge
+	//! An identical request already in flight is joined instead of sent again,
+	//! unless the caller asked to bypass caching
+	protected void SendToAIService(AIRequest request, string prompt, AIServiceCallback serviceCallback)
+	{
+		// Requests rejected before this point never reach the history, so no entry stays pending
+		if (!request.isBatch)
+			ManageHistory(request);
+		
+		AIPendingRequest pending = new AIPendingRequest(request, prompt, serviceCallback);
+		pending.isProviderBatch = request.isBatch && m_Settings.GetProviderBatchEnabled();
+		if (request.isBatch)
+			pending.priority = PRIORITY_BATCH;
+		else
+			pending.priority = GetRequestPriority(request.type);
+		
+		if (!request.bypassCache)
+		{
+			string dedupeKey = request.GetDedupeKey();
+			AIPendingRequest leader = m_InFlightByKey.Get(dedupeKey);
+			if (leader && leader.request && leader.request.IsSameRequest(request))
+			{
+				leader.followers.Insert(pending);
+				m_DedupedRequests++;
+				Print(string.Format("[AI Copilot] Request %1 joined identical request %2 already in flight", pending.requestId, leader.requestId));
+				return;
+			}
+			
+			if (!leader)
+				m_InFlightByKey.Insert(dedupeKey, pending);
+		}
+		
+		if (!pending.isProviderBatch && GetLiveRequestCount() >= GetConcurrencyLimit())
+		{
+			// Higher priority first, FIFO within a priority
+			int queueIndex = m_QueuedRequests.Count();
+			while (queueIndex > 0 && m_QueuedRequests[queueIndex - 1].priority < pending.priority)
+			{
+				queueIndex--;
+			}
+			
+			m_QueuedRequests.InsertAt(pending, queueIndex);
+			Print("[AI Copilot] Request " + pending.requestId + " queued (" + m_QueuedRequests.Count() + " waiting)");
+			return;
+		}
+		
+		if (StartBridgeRequest(pending))
+			return;
+		
+		FinalizeRequestWithError(pending, "Unable to communicate with AI bridge service.");
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Spool the request for the bridge and register it for polling
+	//! The body goes to <id>.req.json; the empty <id>.req.ready marker written
+	//! afterwards tells the bridge the body is complete (FileIO has no rename)
+	protected bool StartBridgeRequest(AIPendingRequest pending)
+	{
+		if (!pending.serviceCallback)
+			return false;
+		
+		string spoolDirectory = m_Settings.GetSpoolDirectory();
+		if (!FileIO.FileExists(spoolDirectory) && !FileIO.MakeDirectory(spoolDirectory))
+			return false;
+		
+		pending.requestFilePath = BuildSpoolPath(pending.requestId, ".req.json");
+		pending.readyFilePath = BuildSpoolPath(pending.requestId, ".req.ready");
+		pending.responseFilePath = BuildSpoolPath(pending.requestId, ".resp.json");
+		pending.streamFilePath = BuildSpoolPath(pending.requestId, ".stream");
+		pending.streamLengthFilePath = BuildSpoolPath(pending.requestId, ".stream.len");
+		pending.timeoutMs = m_ResponseTimeoutMs;
+		if (pending.isProviderBatch)
+			pending.timeoutMs = PROVIDER_BATCH_TIMEOUT_MS;
+		
+		string requestJSON = BuildBridgeRequestJSON(pending);
+		if (requestJSON.IsEmpty())
+			return false;
+		
+		CleanupBridgeFiles(pending);
+		
+		if (!WriteFile(pending.requestFilePath, requestJSON))
+			return false;
+		
+		if (!WriteFile(pending.readyFilePath, ""))
+			return false;
+		
+		pending.startTick = System.GetTickCount();
+		m_ActiveRequests.Insert(pending.requestId, pending);
+		if (pending.isProviderBatch)
+			m_ProviderBatchRequests++;
+		
+		ScheduleBridgePoll(true);
+		return true;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Start queued requests while there are free concurrency slots
+	protected void StartQueuedRequests()
+	{
+		while (!m_QueuedRequests.IsEmpty() && GetLiveRequestCount() < GetConcurrencyLimit())
+		{
+			AIPendingRequest pending = m_QueuedRequests[0];
+			m_QueuedRequests.RemoveOrdered(0);
+			
+			if (!StartBridgeRequest(pending))
+				FinalizeRequestWithError(pending, "Unable to communicate with AI bridge service.");
+		}
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Schedule another poll for the AI bridge response files
+	//! A single poll loop services every active request. Polling starts fast and
+	//! backs off exponentially while the bridge stays quiet; a new submission
+	//! resets the backoff.
+	protected void ScheduleBridgePoll(bool resetBackoff = false)
+	{
+		if (resetBackoff)
+		{
+			m_CurrentPollIntervalMs = m_MinPollIntervalMs;
+			if (m_IsPolling)
+			{
+				GetGame().GetCallqueue().Remove(CheckForBridgeResponse);
+				m_IsPolling = false;
+			}
+		}
+		
+		if (m_IsPolling)
+			return;
+		
+		m_IsPolling = true;
+		GetGame().GetCallqueue().CallLater(CheckForBridgeResponse, m_CurrentPollIntervalMs, false);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Check whether the AI bridge wrote a response file for any active request
+	protected void CheckForBridgeResponse()
+	{
+		m_IsPolling = false;
+		
+		// Only probe the response files once the bridge has signalled a completion
+		bool bridgeSignalled = HasBridgeSequenceChanged();
+		
+		// Snapshot the ids, completing a request mutates the table
+		array<string> requestIds = {};
+		foreach (string requestId, AIPendingRequest pending : m_ActiveRequests)
+		{
+			requestIds.Insert(requestId);
+		}
+		
+		int now = System.GetTickCount();
+		foreach (string id : requestIds)
+		{
+			AIPendingRequest entry = m_ActiveRequests.Get(id);
+			if (!entry)
+				continue;
+			
+			entry.pollCount++;
+			CheckPendingRequest(entry, now, bridgeSignalled);
+		}
+		
+		m_LastPollTick = now;
+		
+		if (bridgeSignalled)
+			m_CurrentPollIntervalMs = m_MinPollIntervalMs;
+		else
+			m_CurrentPollIntervalMs = Math.Min(m_CurrentPollIntervalMs * 2, m_MaxPollIntervalMs);
+		
+		StartQueuedRequests();
+		
+		if (!m_ActiveRequests.IsEmpty())
+			ScheduleBridgePoll();
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Read the bridge's completion counter, a tiny file bumped after every response
+	//! Falls back to probing every tick when the bridge does not publish one
+	protected bool HasBridgeSequenceChanged()
+	{
+		string sequence;
+		if (!TryReadFile(BuildSpoolPath("bridge", ".seq"), sequence))
+			return true;
+		
+		if (sequence == m_LastBridgeSequence)
+			return false;
+		
+		m_LastBridgeSequence = sequence;
+		return true;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Poll the response file of a single request
+	//! The bridge renames the response into place, so its existence means it is complete
+	protected void CheckPendingRequest(AIPendingRequest pending, int now, bool probeResponse)
+	{
+		// Streamed chunks are flushed before the final response, deliver them first
+		if (probeResponse && m_Settings.GetStreamResponses())
+			DeliverStreamedChunk(pending);
+		
+		string responseContent;
+		AIFileReadStats readStats = new AIFileReadStats();
+		if (!probeResponse || !FileIO.FileExists(pending.responseFilePath) || !TryReadFile(pending.responseFilePath, responseContent, readStats))
+		{
+			if (now - pending.startTick >= pending.timeoutMs)
+			{
+				// Same path as CancelRequest, so the provider stops spending tokens on it
+				AbandonBridgeRequest(pending);
+				HandleBridgeError(pending, "Timed out waiting for AI bridge response.");
+			}
+			
+			return;
+		}
+		
+		// The response landed at some point since the previous tick
+		pending.detectionLatencyMs = now - Math.Max(m_LastPollTick, pending.startTick);
+		pending.responseBytes = readStats.bytes;
+		pending.responseReadMs = readStats.elapsedMs;
+		
+		FileIO.DeleteFile(pending.responseFilePath);
+		
+		string responseText;
+		string errorText;
+		if (ParseBridgeResponse(responseContent, pending, responseText, errorText))
+		{
+			HandleBridgeSuccess(pending, responseText);
+		}
+		else
+		{
+			HandleBridgeError(pending, errorText);
+		}
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Read only the bytes appended to <id>.stream since the previous tick
+	//! The bridge publishes the committed length in <id>.stream.len after each append
+	protected void DeliverStreamedChunk(AIPendingRequest pending)
+	{
+		string lengthContent;
+		if (!TryReadFile(pending.streamLengthFilePath, lengthContent))
+			return;
+		
+		int committedLength = lengthContent.Trim().ToInt();
+		if (committedLength <= pending.streamOffset)
+			return;
+		
+		FileHandle file = FileIO.OpenFile(pending.streamFilePath, FileMode.READ);
+		if (!file)
+			return;
+		
+		string chunk;
+		file.Seek(pending.streamOffset);
+		file.Read(chunk, committedLength - pending.streamOffset);
+		file.Close();
+		
+		pending.streamOffset = committedLength;
+		
+		if (chunk.IsEmpty())
+			return;
+		
+		if (pending.serviceCallback)
+			pending.serviceCallback.OnPartial(chunk);
+		
+		foreach (AIPendingRequest follower : pending.followers)
+		{
+			if (follower.serviceCallback)
+				follower.serviceCallback.OnPartial(chunk);
+		}
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Handle successful response from bridge service
+	protected void HandleBridgeSuccess(AIPendingRequest pending, string responseText)
+	{
+		ReleaseRequest(pending);
+		
+		if (pending.request)
+		{
+			pending.request.response = responseText;
+			pending.request.isCompleted = true;
+			pending.request.errorMessage = "";
+			m_History.Complete(pending.request);
+		}
+		
+		Print(string.Format("[AI Copilot] Request %1 answered after %2 polls (detected within %3 ms, read %4 bytes in %5 ms)", pending.requestId, pending.pollCount, pending.detectionLatencyMs, pending.responseBytes, pending.responseReadMs));
+		
+		if (pending.request && pending.inputTokens >= 0)
+			Print(string.Format("[AI Copilot] Request %1 used %2 input tokens (estimated %3, %4 from the prompt cache) and %5 output tokens", pending.requestId, pending.inputTokens, pending.request.estimatedInputTokens, Math.Max(0, pending.cachedInputTokens), pending.outputTokens));
+		
+		if (pending.modelLoadMs >= 0)
+			Print(string.Format("[AI Copilot] Request %1 spent %2 ms loading the local model and %3 ms on inference", pending.requestId, pending.modelLoadMs, pending.inferenceMs));
+		
+		if (pending.serviceCallback)
+			pending.serviceCallback.OnSuccess(responseText);
+		
+		foreach (AIPendingRequest follower : pending.followers)
+		{
+			if (follower.request)
+			{
+				follower.request.response = responseText;
+				follower.request.isCompleted = true;
+				follower.request.errorMessage = "";
+				if (pending.request)
+					follower.request.estimatedInputTokens = pending.request.estimatedInputTokens;
+				m_History.Complete(follower.request);
+			}
+			
+			if (follower.serviceCallback)
+				follower.serviceCallback.OnSuccess(responseText);
+		}
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Handle bridge error
+	protected void HandleBridgeError(AIPendingRequest pending, string errorMessage)
+	{
+		ReleaseRequest(pending);
+		FinalizeRequestWithError(pending, errorMessage);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Finalize immediately when bridge communication fails
+	protected void FinalizeRequestWithError(AIPendingRequest pending, string errorMessage)
+	{
+		CleanupBridgeFiles(pending);
+		ForgetInFlight(pending);
+		CompleteWithError(pending, errorMessage);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Record the error and notify the request and every follower
+	protected void CompleteWithError(AIPendingRequest pending, string errorMessage)
+	{
+		if (pending.request)
+		{
+			pending.request.isCompleted = true;
+			pending.request.errorMessage = errorMessage;
+			m_History.Complete(pending.request);
+		}
+		
+		if (pending.serviceCallback)
+			pending.serviceCallback.OnError(errorMessage);
+		
+		foreach (AIPendingRequest follower : pending.followers)
+		{
+			if (follower.request)
+			{
+				follower.request.isCompleted = true;
+				follower.request.errorMessage = errorMessage;
+				m_History.Complete(follower.request);
+			}
+			
+			if (follower.serviceCallback)
+				follower.serviceCallback.OnError(errorMessage);
+		}
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Stop routing identical submissions to a request that is finishing
+	protected void ForgetInFlight(AIPendingRequest pending)
+	{
+		if (!pending.request || pending.request.bypassCache)
+			return;
+		
+		string dedupeKey = pending.request.GetDedupeKey();
+		if (m_InFlightByKey.Get(dedupeKey) == pending)
+			m_InFlightByKey.Remove(dedupeKey);
+	}
+	
+	//-----------------------------------------------------------------------------
+	protected void RemoveActiveRequest(AIPendingRequest pending)
+	{
+		if (!m_ActiveRequests.Contains(pending.requestId))
+			return;
+		
+		if (pending.isProviderBatch)
+			m_ProviderBatchRequests--;
+		
+		m_ActiveRequests.Remove(pending.requestId);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Drop a request from the active table and remove its bridge files
+	protected void ReleaseRequest(AIPendingRequest pending)
+	{
+		RemoveActiveRequest(pending);
+		CleanupBridgeFiles(pending);
+		ForgetInFlight(pending);
+		
+		if (pending.request)
+		{
+			pending.request.pollCount = pending.pollCount;
+			pending.request.detectionLatencyMs = pending.detectionLatencyMs;
+			pending.request.responseBytes = pending.responseBytes;
+			pending.request.responseReadMs = pending.responseReadMs;
+			pending.request.inputTokens = pending.inputTokens;
+			pending.request.outputTokens = pending.outputTokens;
+		}
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Tell the bridge to abort a running request with a <id>.cancel marker and
+	//! remove its spool files, including a response or stream it already wrote.
+	//! Output the bridge writes after seeing the marker is removed by the bridge.
+	protected void AbandonBridgeRequest(AIPendingRequest pending)
+	{
+		WriteFile(BuildSpoolPath(pending.requestId, ".cancel"), "");
+		CleanupBridgeFiles(pending);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Remove any leftover request/response files to avoid stale data
+	protected void CleanupBridgeFiles(AIPendingRequest pending)
+	{
+		if (!pending.requestFilePath.IsEmpty())
+			DeleteFileIfExists(pending.requestFilePath);
+		
+		if (!pending.readyFilePath.IsEmpty())
+			DeleteFileIfExists(pending.readyFilePath);
+		
+		if (!pending.responseFilePath.IsEmpty())
+			DeleteFileIfExists(pending.responseFilePath);
+		
+		if (!pending.streamFilePath.IsEmpty())
+			DeleteFileIfExists(pending.streamFilePath);
+		
+		if (!pending.streamLengthFilePath.IsEmpty())
+			DeleteFileIfExists(pending.streamLengthFilePath);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Build the path of a spool file, e.g. <spool>/<id>.resp.json
+	protected string BuildSpoolPath(string requestId, string suffix)
+	{
+		string spoolDirectory = m_Settings.GetSpoolDirectory();
+		if (!spoolDirectory.EndsWith("/") && !spoolDirectory.EndsWith(":"))
+			spoolDirectory += "/";
+		
+		return spoolDirectory + requestId + suffix;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Create a request id that stays unique across Workbench instances sharing a profile
+	protected string GenerateRequestId()
+	{
+		m_RequestCounter++;
+		return string.Format("%1-%2-%3", System.GetTickCount(), Math.RandomInt(1000, 10000), m_RequestCounter);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Active requests that hold a live provider call, i.e. not waiting on a provider batch
+	protected int GetLiveRequestCount()
+	{
+		return m_ActiveRequests.Count() - m_ProviderBatchRequests;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Number of requests allowed in flight against the bridge
+	protected int GetConcurrencyLimit()
+	{
+		return Math.Max(1, m_Settings.GetMaxConcurrentRequests());
+	}
 
 protected void DeleteFileIfExists(string path)
 {
@@ -384,204 +1025,116 @@ FileIO.DeleteFile(path);
 
 //----------------------------------------------------------------------------- 
 //! Read file content if available
-protected bool TryReadFile(string path, out string content)
-{
-content = "";
-
-FileHandle file = FileIO.OpenFile(path, FileMode.READ);
-if (!file)
-return false;
-
-string line;
-while (file.ReadLine(line) != 0)
+protected bool TryReadFile(string path, out string content, AIFileReadStats stats = null)
 {
-content += line;
-content += "\n";
-}
-
-file.Close();
-return true;
+return AIFileUtils.ReadAll(path, content, stats);
 }
 
 //----------------------------------------------------------------------------- 
 //! Write content to specified file path
 protected bool WriteFile(string path, string content)
 {
-FileHandle file = FileIO.OpenFile(path, FileMode.WRITE);
-if (!file)
-return false;
-
-file.Write(content);
-file.Close();
-return true;
+return AIFileUtils.WriteAll(path, content);
 }
 
 //----------------------------------------------------------------------------- 
 //! Parse JSON content from bridge response
-protected bool ParseBridgeResponse(string jsonContent, out string responseText, out string errorText)
+protected bool ParseBridgeResponse(string jsonContent, AIPendingRequest pending, out string responseText, out string errorText)
 {
 responseText = "";
 errorText = "";
 
-bool successFlag;
-if (TryParseJSONBool(jsonContent, "success", successFlag) && !successFlag)
-{
-if (!TryParseJSONString(jsonContent, "error", errorText))
-errorText = "AI bridge reported an unknown error.";
-return false;
-}
-
-if (TryParseJSONString(jsonContent, "response", responseText) && !responseText.IsEmpty())
-return true;
-
-if (!TryParseJSONString(jsonContent, "error", errorText) || errorText.IsEmpty())
-errorText = "AI bridge returned an empty response.";
-
-return false;
-}
-
-//----------------------------------------------------------------------------- 
-//! Extract string value from simple JSON
-protected bool TryParseJSONString(string jsonContent, string key, out string value)
+string parseError;
+AIJSONValue root = AIJSONReader.Parse(jsonContent, parseError);
+if (!root || !root.IsObject())
 {
-value = "";
-string search = "\"" + key + "\"";
-int keyIndex = jsonContent.IndexOf(search);
-if (keyIndex == -1)
-return false;
-
-int colonIndex = jsonContent.IndexOf(":", keyIndex);
-if (colonIndex == -1)
-return false;
-
-colonIndex++;
-while (colonIndex < jsonContent.Length())
-{
-string ch = jsonContent.Substring(colonIndex, 1);
-if (ch == " " || ch == "\t" || ch == "\n" || ch == "\r")
-{
-colonIndex++;
-continue;
-}
-
-if (ch != "\"")
+errorText = "AI bridge returned malformed JSON";
+if (!parseError.IsEmpty())
+errorText += ": " + parseError;
 return false;
-
-colonIndex++;
-break;
-}
-
-string result = "";
-bool escaping = false;
-
-for (int i = colonIndex; i < jsonContent.Length(); i++)
-{
-string charStr = jsonContent.Substring(i, 1);
-if (!escaping)
-{
-if (charStr == "\\")
-{
-escaping = true;
-continue;
-}
-
-if (charStr == "\"")
-{
-value = result;
-return true;
 }
 
-result += charStr;
-}
-else
+// Token usage reported by the provider, absent for cache hits and some local models
+AIJSONValue usage = root.Get("usage");
+if (usage && usage.IsObject())
 {
-if (charStr == "n")
-result += "\n";
-else if (charStr == "r")
-result += "\r";
-else if (charStr == "t")
-result += "\t";
-else if (charStr == "\"")
-result += "\"";
-else if (charStr == "\\")
-result += "\\";
-else
-result += charStr;
-
-escaping = false;
-}
-}
-
-value = result;
-return true;
+pending.inputTokens = usage.GetInt("inputTokens", -1);
+pending.outputTokens = usage.GetInt("outputTokens", -1);
+pending.cachedInputTokens = usage.GetInt("cachedInputTokens", -1);
+pending.modelLoadMs = usage.GetInt("loadMs", -1);
+if (pending.modelLoadMs >= 0)
+pending.inferenceMs = usage.GetInt("promptEvalMs", 0) + usage.GetInt("evalMs", 0);
 }
 
-//----------------------------------------------------------------------------- 
-//! Extract boolean value from simple JSON
-protected bool TryParseJSONBool(string jsonContent, string key, out bool value)
+if (!root.GetBool("success", true))
 {
-value = false;
-string search = "\"" + key + "\"";
-int keyIndex = jsonContent.IndexOf(search);
-if (keyIndex == -1)
-return false;
-
-int colonIndex = jsonContent.IndexOf(":", keyIndex);
-if (colonIndex == -1)
+errorText = root.GetString("error");
+if (errorText.IsEmpty())
+errorText = "AI bridge reported an unknown error.";
 return false;
-
-colonIndex++;
-while (colonIndex < jsonContent.Length())
-{
-string token = jsonContent.Substring(colonIndex, 1);
-if (token == " " || token == "\t" || token == "\n" || token == "\r")
-{
-colonIndex++;
-continue;
-}
-
-string remainingTrue = jsonContent.Substring(colonIndex, Math.Min(4, jsonContent.Length() - colonIndex));
-if (remainingTrue == "true")
-{
-value = true;
-return true;
 }
 
-string remainingFalse = jsonContent.Substring(colonIndex, Math.Min(5, jsonContent.Length() - colonIndex));
-if (remainingFalse == "false")
-{
-value = false;
+responseText = root.GetString("response");
+if (!responseText.IsEmpty())
 return true;
-}
 
-break;
-}
+errorText = root.GetString("error");
+if (errorText.IsEmpty())
+errorText = "AI bridge returned an empty response.";
 
 return false;
 }
 	
 //----------------------------------------------------------------------------- 
 //! Construct JSON payload for the bridge
-protected string BuildBridgeRequestJSON(string prompt)
+protected string BuildBridgeRequestJSON(AIPendingRequest pending)
 {
-if (!m_ActiveRequest)
+if (!pending.request)
 return "";
 
 string service = m_Settings.GetServiceIdentifier();
 if (service.IsEmpty())
 return "";
 
-string json = "{\n";
-json += "  \"service\": \"" + service + "\",\n";
-json += "  \"prompt\": \"" + EscapeJSONString(prompt) + "\",\n";
-json += "  \"model\": \"" + EscapeJSONString(m_Settings.GetModelName()) + "\",\n";
+// Collect pieces and join once; the escaped prompt can be tens of KB
+ref array<string> pieces = {};
+pieces.Insert("{\n");
+pieces.Insert("  \"requestId\": \"" + pending.requestId + "\",\n");
+pieces.Insert("  \"service\": \"" + service + "\",\n");
+if (!pending.request.systemPrompt.IsEmpty())
+{
+pieces.Insert("  \"system\": \"");
+pieces.Insert(EscapeJSONString(pending.request.systemPrompt));
+pieces.Insert("\",\n");
+}
+pieces.Insert("  \"prompt\": \"");
+pieces.Insert(EscapeJSONString(pending.prompt));
+pieces.Insert("\",\n");
+pieces.Insert("  \"model\": \"" + EscapeJSONString(m_Settings.GetModelName()) + "\",\n");
 
 ref array<string> settingsEntries = {};
 settingsEntries.Insert("\"maxTokens\": " + m_Settings.GetMaxTokens());
 settingsEntries.Insert("\"temperature\": " + m_Settings.GetTemperature());
-settingsEntries.Insert("\"timeout\": " + m_ResponseTimeoutMs);
-settingsEntries.Insert("\"request_file\": \"" + EscapeJSONString(m_Settings.GetRequestFilePath()) + "\"");
-settingsEntries.Insert("\"response_file\": \"" + EscapeJSONString(m_Settings.GetResponseFilePath()) + "\"");
+settingsEntries.Insert("\"timeout\": " + pending.timeoutMs);
+settingsEntries.Insert("\"stream\": " + (m_Settings.GetStreamResponses() ? "true" : "false"));
+settingsEntries.Insert("\"priority\": " + pending.priority);
+
+if (service == "ollama")
+{
+if (m_Settings.GetLocalContextTokens() > 0)
+settingsEntries.Insert("\"numCtx\": " + m_Settings.GetLocalContextTokens());
+if (m_Settings.GetLocalThreads() > 0)
+settingsEntries.Insert("\"numThread\": " + m_Settings.GetLocalThreads());
+}
+
+if (pending.request.bypassCache)
+{
+settingsEntries.Insert("\"bypassCache\": true");
+}
+if (pending.isProviderBatch)
+{
+settingsEntries.Insert("\"batch\": true");
+}
 
 string apiKey = m_Settings.GetAPIKey();
 if (!apiKey.IsEmpty())
@@ -596,23 +1149,22 @@ settingsEntries.Insert("\"endpoint\": \"" + endpointEscaped + "\"");
 settingsEntries.Insert("\"customEndpoint\": \"" + endpointEscaped + "\"");
 }
 
-json += "  \"settings\": {\n";
+pieces.Insert("  \"settings\": {\n");
 for (int i = 0; i < settingsEntries.Count(); i++)
 {
-json += "    " + settingsEntries[i];
 if (i < settingsEntries.Count() - 1)
-json += ",\n";
+pieces.Insert("    " + settingsEntries[i] + ",\n");
 else
-json += "\n";
+pieces.Insert("    " + settingsEntries[i] + "\n");
 }
-json += "  },\n";
-json += "  \"metadata\": {\n";
-json += "    \"requestType\": \"" + EscapeJSONString(EnumToString(typeof(AIRequestType), m_ActiveRequest.type)) + "\",\n";
-json += "    \"context\": \"" + EscapeJSONString(BuildContextSummary(m_ActiveRequest)) + "\"\n";
-json += "  }\n";
-json += "}\n";
-
-return json;
+pieces.Insert("  },\n");
+pieces.Insert("  \"metadata\": {\n");
+pieces.Insert("    \"requestType\": \"" + EscapeJSONString(EnumToString(typeof(AIRequestType), pending.request.type)) + "\",\n");
+pieces.Insert("    \"context\": \"" + EscapeJSONString(BuildContextSummary(pending.request)) + "\"\n");
+pieces.Insert("  }\n");
+pieces.Insert("}\n");
+
+return AIJSONUtils.JoinStrings(pieces);
 }
 
 //----------------------------------------------------------------------------- 
@@ -622,16 +1174,20 @@ protected string BuildContextSummary(AIRequest request)
 if (!request)
 return "";
 
-string summary = "Module=" + request.context.currentModule;
+AIRequestContext context = request.context;
+if (!context)
+return "";
+
+string summary = "Module=" + context.GetModule();
 
-if (!request.context.currentScript.IsEmpty())
-summary += ", Script=" + request.context.currentScript;
+if (!context.GetScriptPath().IsEmpty())
+summary += ", Script=" + context.GetScriptPath();
 
-if (request.context.selectedResources && request.context.selectedResources.Count() > 0)
-summary += ", Resources=" + request.context.selectedResources.Count().ToString();
+if (context.GetResourceCount() > 0)
+summary += ", Resources=" + context.GetResourceCount().ToString();
 
-if (request.context.selectedEntities && request.context.selectedEntities.Count() > 0)
-summary += ", Entities=" + request.context.selectedEntities.Count().ToString();
+if (context.GetEntityCount() > 0)
+summary += ", Entities=" + context.GetEntityCount().ToString();
 
 return summary;
 }
@@ -640,129 +1196,244 @@ return summary;
 //! Escape text for inclusion in JSON
 protected string EscapeJSONString(string value)
 {
-string result = "";
-for (int i = 0; i < value.Length(); i++)
-{
-string ch = value.Substring(i, 1);
-switch (ch)
+return AIJSONUtils.EscapeString(value);
+}
+
+//----------------------------------------------------------------------------- 
+//! Maintain request history according to user settings
+//! Capacity and persistence follow the settings through OnSettingChanged
+protected void ManageHistory(AIRequest request)
 {
-case "\\":
-result += "\\\\";
-break;
-case "\"":
-result += "\\\"";
-break;
-case "\n":
-result += "\\n";
-break;
-case "\r":
-result += "\\r";
-break;
-case "\t":
-result += "\\t";
-break;
-default:
-result += ch;
-break;
+m_History.Add(request);
 }
+
+//----------------------------------------------------------------------------- 
+//! Only the latest request is kept when history saving is disabled
+protected int GetHistoryCapacity()
+{
+if (!m_Settings.GetSaveRequestHistory())
+return 1;
+
+return Math.Max(1, m_Settings.GetMaxHistoryEntries());
 }
 
-return result;
+//----------------------------------------------------------------------------- 
+//! Start a prompt limited to the configured input-token budget, opened by the
+//! shared system preamble
+protected AIPromptBuilder CreatePromptBuilder()
+{
+AIPromptBuilder builder = new AIPromptBuilder(m_Settings.GetPromptTokenBudget());
+builder.AddSystemText(SYSTEM_PREAMBLE);
+return builder;
 }
 
 //----------------------------------------------------------------------------- 
-//! Maintain request history according to user settings
-protected void ManageHistory(AIRequest request)
+//! Add code context by priority: the selection, then the class enclosing it,
+//! then the header of the current script, then related project definitions
+protected void AddCodeContext(AIPromptBuilder builder, AIRequest request, string code, string header)
 {
-if (!m_Settings.GetSaveRequestHistory())
+builder.AddContext(header, code, 1, AIPromptTrim.KEEP_CENTER);
+
+string script = request.context.GetScriptText();
+if (!script.IsEmpty() && script != code)
+{
+int selectionOffset = -1;
+if (!code.IsEmpty())
+selectionOffset = script.IndexOf(code);
+
+if (selectionOffset > 0)
+builder.AddContext("Enclosing class (up to the selection):\n", AIPromptBuilder.FindEnclosingClass(script, selectionOffset), 2, AIPromptTrim.KEEP_HEAD);
+
+builder.AddContext("File header:\n", AIPromptBuilder.ExtractFileHeader(script), 3, AIPromptTrim.KEEP_HEAD);
+}
+
+AddRelatedDefinitions(builder, request);
+}
+
+//----------------------------------------------------------------------------- 
+//! Add project definitions related to the request, after all other context
+//! Candidates come from the script index, ranked by how rarely their name
+//! tokens occur; a definition nested in one already added is skipped
+protected void AddRelatedDefinitions(AIPromptBuilder builder, AIRequest request)
 {
-m_RequestHistory.Clear();
-m_RequestHistory.Insert(request);
+int topK = m_Settings.GetCodeIndexTopK();
+if (!m_CodeIndex || topK <= 0)
 return;
+
+UpdateCodeIndex(CODE_INDEX_PROMPT_BUDGET_MS);
+
+string query = request.userInput + "\n" + request.context.GetSelection();
+array<AICodeSymbol> symbols = m_CodeIndex.Search(query, topK * 2, request.context.GetScriptPath());
+
+map<string, string> fileCache = new map<string, string>();
+array<AICodeSymbol> added = {};
+foreach (AICodeSymbol symbol : symbols)
+{
+if (added.Count() >= topK)
+break;
+
+bool nested = false;
+foreach (AICodeSymbol outer : added)
+{
+if (outer.path == symbol.path && symbol.start >= outer.start && symbol.start < outer.start + outer.length)
+{
+nested = true;
+break;
+}
+}
+
+if (nested)
+continue;
+
+string definition = m_CodeIndex.ReadDefinition(symbol, fileCache);
+if (definition.IsEmpty())
+continue;
+
+definition = AIPromptBuilder.TrimToChars(definition, MAX_DEFINITION_CHARS, AIPromptTrim.KEEP_HEAD);
+builder.AddContext("Related " + symbol.Describe() + ":\n", definition, 4, AIPromptTrim.KEEP_HEAD);
+added.Insert(symbol);
+}
 }
 
-int maxEntries = Math.Max(1, m_Settings.GetMaxHistoryEntries());
-while (m_RequestHistory.Count() > maxEntries)
+//----------------------------------------------------------------------------- 
+//! Read the script open in the Script Editor, if any
+protected string ReadCurrentScript(WorkbenchContext context)
 {
-m_RequestHistory.RemoveOrdered(0);
+string script;
+if (!context || context.currentScript.IsEmpty() || !AIFileUtils.ReadAll(context.currentScript, script))
+return "";
+
+return script;
 }
+
+//----------------------------------------------------------------------------- 
+//! Build the prompt and record its estimated size on the request
+protected string FinishPrompt(AIPromptBuilder builder, AIRequest request)
+{
+string prompt = builder.Build();
+request.systemPrompt = builder.GetSystemPrompt();
+request.estimatedInputTokens = builder.GetEstimatedTokens();
+
+if (builder.GetTrimmedTokens() > 0)
+Print(string.Format("[AI Copilot] Request %1: trimmed ~%2 tokens of context to fit the %3 token budget", request.requestId, builder.GetTrimmedTokens(), m_Settings.GetPromptTokenBudget()));
+
+return prompt;
 }
 
 //----------------------------------------------------------------------------- 
 //! Build prompt for general conversation
 protected string BuildGeneralChatPrompt(AIRequest request)
 {
-string prompt = "You are an AI copilot embedded in the Arma Reforger Workbench.\n";
-prompt += "Assist with scripting, configuration and tooling questions.\n\n";
-prompt += "User request:\n" + request.userInput + "\n\n";
+AIPromptBuilder builder = CreatePromptBuilder();
+builder.AddText("User request:\n" + request.userInput + "\n\n");
 
-string selectedCode = GetSelectedCode(request.context);
-if (!selectedCode.IsEmpty())
-{
-prompt += "Selected code context:\n" + selectedCode + "\n\n";
-}
+AddCodeContext(builder, request, request.context.GetSelection(), "Selected code context:\n");
 
-prompt += "Workbench context: " + BuildContextSummary(request) + "\n";
-return prompt;
+builder.AddText("Workbench context: " + BuildContextSummary(request) + "\n");
+return FinishPrompt(builder, request);
 }
 
 //----------------------------------------------------------------------------- 
 //! Build prompt for code generation
 	protected string BuildCodeGenerationPrompt(AIRequest request)
 	{
-		string prompt = "Generate Arma Reforger Enforce Script code based on this request:\n\n";
-		prompt += request.userInput + "\n\n";
-		prompt += "Context:\n";
-		prompt += "- Current module: " + request.context.currentModule + "\n";
-		prompt += "- Use proper Enforce Script syntax\n";
-		prompt += "- Follow Arma Reforger coding conventions\n";
-		prompt += "- Include appropriate comments\n";
-		prompt += "- Ensure code is production-ready\n";
+		AIPromptBuilder builder = CreatePromptBuilder();
+		builder.AddSystemText("\nWhen generating code:\n");
+		builder.AddSystemText("- Use proper Enforce Script syntax\n");
+		builder.AddSystemText("- Follow Arma Reforger coding conventions\n");
+		builder.AddSystemText("- Include appropriate comments\n");
+		builder.AddSystemText("- Ensure code is production-ready\n");
+		builder.AddText("Generate Arma Reforger Enforce Script code based on this request:\n\n");
+		builder.AddText(request.userInput + "\n\n");
+		builder.AddText("Context:\n");
+		builder.AddText("- Current module: " + request.context.GetModule() + "\n\n");
+		AddRelatedDefinitions(builder, request);
 		
-		return prompt;
+		return FinishPrompt(builder, request);
 	}
 	
 	//-----------------------------------------------------------------------------
 	//! Build prompt for code analysis
-	protected string BuildCodeAnalysisPrompt(string code, string userRequest)
+	protected string BuildCodeAnalysisPrompt(AIRequest request, string code)
+	{
+		AIPromptBuilder builder = CreatePromptBuilder();
+		builder.AddSystemText("\nWhen analysing code, provide:\n");
+		builder.AddSystemText("- Code quality assessment\n");
+		builder.AddSystemText("- Potential bugs or issues\n");
+		builder.AddSystemText("- Performance considerations\n");
+		builder.AddSystemText("- Best practice recommendations\n");
+		builder.AddText("Analyze this Arma Reforger Enforce Script code:\n\n");
+		AddCodeContext(builder, request, code, "");
+		builder.AddText("Focus on: " + request.userInput + "\n");
+		
+		return FinishPrompt(builder, request);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Instruction, file header and one batch chunk, then the job's instructions
+	protected string BuildBatchPrompt(AIRequest request, string code, string header)
 	{
-		string prompt = "Analyze this Arma Reforger Enforce Script code:\n\n";
-		prompt += code + "\n\n";
-		prompt += "Focus on: " + userRequest + "\n\n";
-		prompt += "Please provide:\n";
-		prompt += "- Code quality assessment\n";
-		prompt += "- Potential bugs or issues\n";
-		prompt += "- Performance considerations\n";
-		prompt += "- Best practice recommendations\n";
+		AIPromptBuilder builder = CreatePromptBuilder();
+		string inputLabel = "Documentation type: ";
+		if (request.type == AIRequestType.CODE_ANALYSIS)
+		{
+			builder.AddSystemText("\nWhen analysing code, provide:\n");
+			builder.AddSystemText("- Code quality assessment\n");
+			builder.AddSystemText("- Potential bugs or issues\n");
+			builder.AddSystemText("- Performance considerations\n");
+			builder.AddSystemText("- Best practice recommendations\n");
+			builder.AddText("Analyze this Arma Reforger Enforce Script code:\n\n");
+			inputLabel = "Focus on: ";
+		}
+		else
+		{
+			builder.AddText("Generate documentation for this Arma Reforger code:\n\n");
+		}
 		
-		return prompt;
+		builder.AddContext("", code, 1, AIPromptTrim.KEEP_CENTER);
+		builder.AddContext("File header:\n", AIPromptBuilder.TrimToChars(header, MAX_BATCH_HEADER_CHARS, AIPromptTrim.KEEP_HEAD), 2, AIPromptTrim.KEEP_HEAD);
+		builder.AddText(inputLabel + request.userInput);
+		
+		return FinishPrompt(builder, request);
 	}
 	
 	//-----------------------------------------------------------------------------
 	//! Build other prompt methods...
-	protected string BuildDebuggingPrompt(string code, string errorInfo)
+	protected string BuildDebuggingPrompt(AIRequest request, string code)
+	{
+		return BuildCodeTaskPrompt(request, code, "Debug this Arma Reforger code:\n\n", "Error/Issue: ");
+	}
+	
+	protected string BuildDocumentationPrompt(AIRequest request, string code)
 	{
-		return "Debug this Arma Reforger code:\n\n" + code + "\n\nError/Issue: " + errorInfo;
+		return BuildCodeTaskPrompt(request, code, "Generate documentation for this Arma Reforger code:\n\n", "Documentation type: ");
 	}
 	
-	protected string BuildDocumentationPrompt(string code, string docType)
+	protected string BuildOptimizationPrompt(AIRequest request, string code)
 	{
-		return "Generate documentation for this Arma Reforger code:\n\n" + code + "\n\nDocumentation type: " + docType;
+		return BuildCodeTaskPrompt(request, code, "Optimize this Arma Reforger code:\n\n", "Optimization focus: ");
 	}
 	
-	protected string BuildOptimizationPrompt(string code, string focusArea)
+	protected string BuildExplanationPrompt(AIRequest request, string code)
 	{
-		return "Optimize this Arma Reforger code:\n\n" + code + "\n\nOptimization focus: " + focusArea;
+		return BuildCodeTaskPrompt(request, code, "Explain this Arma Reforger code:\n\n", "Specific question: ");
 	}
 	
-	protected string BuildExplanationPrompt(string code, string question)
+	protected string BuildRefactoringPrompt(AIRequest request, string code)
 	{
-		return "Explain this Arma Reforger code:\n\n" + code + "\n\nSpecific question: " + question;
+		return BuildCodeTaskPrompt(request, code, "Refactor this Arma Reforger code:\n\n", "Refactoring goal: ");
 	}
 	
-	protected string BuildRefactoringPrompt(string code, string refactorGoal)
+	//-----------------------------------------------------------------------------
+	//! Instruction, code context, then the user's input under a label
+	protected string BuildCodeTaskPrompt(AIRequest request, string code, string instruction, string inputLabel)
 	{
-		return "Refactor this Arma Reforger code:\n\n" + code + "\n\nRefactoring goal: " + refactorGoal;
+		AIPromptBuilder builder = CreatePromptBuilder();
+		builder.AddText(instruction);
+		AddCodeContext(builder, request, code, "");
+		builder.AddText(inputLabel + request.userInput);
+		
+		return FinishPrompt(builder, request);
 	}
 	
 //----------------------------------------------------------------------------- 
@@ -773,16 +1444,44 @@ return m_Settings;
 }
 
 //----------------------------------------------------------------------------- 
-//! Get request history
-array<ref AIRequest> GetRequestHistory()
+//! Get request history summaries, oldest first
+array<ref AIHistoryEntry> GetRequestHistory()
 {
-return m_RequestHistory;
+return m_History.GetEntries();
+}
+
+//----------------------------------------------------------------------------- 
+//! Load the full response of a history entry from disk
+string GetHistoryResponse(AIHistoryEntry entry)
+{
+return m_History.LoadResponse(entry);
 }
 	
 	//-----------------------------------------------------------------------------
-	//! Check if currently processing
+	//! Check if any request is in flight or waiting for a slot
 	bool IsProcessing()
 	{
-		return m_IsProcessing;
+		return !m_ActiveRequests.IsEmpty() || !m_QueuedRequests.IsEmpty();
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Number of requests currently awaiting a bridge response
+	int GetActiveRequestCount()
+	{
+		return m_ActiveRequests.Count();
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Number of requests waiting for a free concurrency slot
+	int GetQueuedRequestCount()
+	{
+		return m_QueuedRequests.Count();
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Number of submissions answered by joining an identical request in flight
+	int GetDedupedRequestCount()
+	{
+		return m_DedupedRequests;
 	}
 }
\ No newline at end of file
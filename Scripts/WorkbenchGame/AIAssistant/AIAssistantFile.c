@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+//! File helpers shared by the AI Assistant core and settings
+//-----------------------------------------------------------------------------
+
+//! Size and timing of the most recent AIFileUtils.ReadAll call
+class AIFileReadStats
+{
+	int bytes;
+	int elapsedMs;
+	int blocks;
+
+	void AIFileReadStats()
+	{
+		bytes = 0;
+		elapsedMs = 0;
+		blocks = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+class AIFileUtils
+{
+	//! Block size for whole-file reads
+	protected static const int READ_BLOCK_SIZE = 65536;
+
+	//-----------------------------------------------------------------------------
+	//! Read a whole file in large blocks and join them once
+	//! Unlike a ReadLine loop the content is byte-for-byte identical to the file,
+	//! line endings included, and the cost is linear in the file size
+	static bool ReadAll(string path, out string content, AIFileReadStats stats = null)
+	{
+		content = "";
+		int startTick = System.GetTickCount();
+
+		FileHandle file = FileIO.OpenFile(path, FileMode.READ);
+		if (!file)
+			return false;
+
+		int length = file.GetLength();
+		int remaining = length;
+		array<string> blocks = {};
+
+		while (remaining > 0)
+		{
+			string block;
+			int blockLength = Math.Min(remaining, READ_BLOCK_SIZE);
+			int readLength = file.Read(block, blockLength);
+			if (readLength <= 0)
+				break;
+
+			blocks.Insert(block);
+			remaining -= readLength;
+		}
+
+		file.Close();
+
+		content = AIJSONUtils.JoinStrings(blocks);
+
+		if (stats)
+		{
+			stats.bytes = length - remaining;
+			stats.blocks = blocks.Count();
+			stats.elapsedMs = System.GetTickCount() - startTick;
+		}
+
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Write content to a file, replacing what was there
+	static bool WriteAll(string path, string content)
+	{
+		FileHandle file = FileIO.OpenFile(path, FileMode.WRITE);
+		if (!file)
+			return false;
+
+		file.Write(content);
+		file.Close();
+		return true;
+	}
+}
@@ -0,0 +1,615 @@
+//-----------------------------------------------------------------------------
+//! Request history
+//! Keeps compact summaries in a fixed-size ring buffer and stores full
+//! response bodies out of line in paged files under $profile:
+//-----------------------------------------------------------------------------
+
+//! Summary of one history entry; the full response lives in a page file
+class AIHistoryEntry
+{
+	string requestId;
+	AIRequestType type;
+	int timestamp;
+	string userInput;
+	bool isCompleted;
+	string errorMessage;
+	int pollCount;
+	int detectionLatencyMs;
+	int responseBytes;
+	int responseReadMs;
+	int estimatedInputTokens;
+	int inputTokens;
+	int outputTokens;
+	//! First characters of the response for list views
+	string responsePreview;
+	int responseLength;
+	//! Location of the full response record, page -1 when not persisted
+	int page;
+	int offset;
+	int length;
+	//! Live request while it is in flight, dropped once completed
+	ref AIRequest request;
+
+	void AIHistoryEntry()
+	{
+		timestamp = 0;
+		userInput = "";
+		isCompleted = false;
+		errorMessage = "";
+		pollCount = 0;
+		detectionLatencyMs = -1;
+		responseBytes = 0;
+		responseReadMs = 0;
+		estimatedInputTokens = 0;
+		inputTokens = -1;
+		outputTokens = -1;
+		responsePreview = "";
+		responseLength = 0;
+		page = -1;
+		offset = 0;
+		length = 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Copy the summary fields of a request, truncating the long ones
+	void UpdateFrom(AIRequest source, int previewLength)
+	{
+		requestId = source.requestId;
+		type = source.type;
+		timestamp = source.timestamp;
+		userInput = AIRequestHistory.Truncate(source.userInput, previewLength);
+		isCompleted = source.isCompleted;
+		errorMessage = source.errorMessage;
+		pollCount = source.pollCount;
+		detectionLatencyMs = source.detectionLatencyMs;
+		responseBytes = source.responseBytes;
+		responseReadMs = source.responseReadMs;
+		estimatedInputTokens = source.estimatedInputTokens;
+		inputTokens = source.inputTokens;
+		outputTokens = source.outputTokens;
+		responsePreview = AIRequestHistory.Truncate(source.response, previewLength);
+		responseLength = source.response.Length();
+	}
+}
+
+//-----------------------------------------------------------------------------
+class AIRequestHistory
+{
+	//! Characters of input/response kept in memory per entry
+	static const int PREVIEW_LENGTH = 200;
+	//! Response records per page file
+	protected static const int ENTRIES_PER_PAGE = 25;
+
+	protected string m_Directory;
+	protected string m_IndexPath;
+	protected bool m_Persist;
+
+	protected ref array<ref AIHistoryEntry> m_Slots;
+	protected int m_Capacity;
+	protected int m_Head; // slot of the oldest entry
+	protected int m_Count;
+	protected int m_IndexLines;
+
+	protected int m_CurrentPage;
+	protected int m_CurrentPageEntries;
+	protected int m_CurrentPageBytes;
+	//! Live entries per page file; a page is deleted when its count drops to zero
+	protected ref map<int, int> m_PageRefs;
+
+	//-----------------------------------------------------------------------------
+	void AIRequestHistory(string directory, int capacity, bool persist)
+	{
+		m_Directory = directory;
+		m_IndexPath = directory + "/index.jsonl";
+		m_Persist = persist;
+		m_Slots = {};
+		m_Capacity = 0;
+		m_Head = 0;
+		m_Count = 0;
+		m_IndexLines = 0;
+		m_CurrentPage = 0;
+		m_CurrentPageEntries = 0;
+		m_CurrentPageBytes = 0;
+		m_PageRefs = new map<int, int>();
+
+		SetCapacity(capacity);
+
+		if (m_Persist)
+			Load();
+	}
+
+	//-----------------------------------------------------------------------------
+	static string Truncate(string text, int maxLength)
+	{
+		if (text.Length() <= maxLength)
+			return text;
+
+		return text.Substring(0, maxLength) + "...";
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Resize the ring, keeping the newest entries; O(n) but only on settings changes
+	void SetCapacity(int capacity)
+	{
+		capacity = Math.Max(1, capacity);
+		if (capacity == m_Capacity)
+			return;
+
+		array<ref AIHistoryEntry> entries = GetEntries();
+		while (entries.Count() > capacity)
+		{
+			ReleasePage(entries[0]);
+			entries.RemoveOrdered(0);
+		}
+
+		m_Slots = {};
+		m_Slots.Resize(capacity);
+		m_Capacity = capacity;
+		m_Head = 0;
+		m_Count = entries.Count();
+
+		for (int i = 0; i < m_Count; i++)
+		{
+			m_Slots[i] = entries[i];
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	void SetPersist(bool persist)
+	{
+		m_Persist = persist;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Record a new request; evicts the oldest entry in O(1) when full
+	void Add(AIRequest request)
+	{
+		AIHistoryEntry entry = new AIHistoryEntry();
+		entry.UpdateFrom(request, PREVIEW_LENGTH);
+		entry.request = request;
+		Push(entry);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Refresh the summary of a finished request and move its response to disk
+	void Complete(AIRequest request)
+	{
+		AIHistoryEntry entry = Find(request.requestId);
+		if (!entry)
+			return;
+
+		entry.UpdateFrom(request, PREVIEW_LENGTH);
+		entry.request = null;
+
+		if (!m_Persist)
+			return;
+
+		AppendResponse(entry, request.response);
+		AppendIndexLine(entry);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Entries oldest first
+	array<ref AIHistoryEntry> GetEntries()
+	{
+		array<ref AIHistoryEntry> entries = {};
+		for (int i = 0; i < m_Count; i++)
+		{
+			entries.Insert(m_Slots[(m_Head + i) % m_Capacity]);
+		}
+
+		return entries;
+	}
+
+	//-----------------------------------------------------------------------------
+	int Count()
+	{
+		return m_Count;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Entry by age, 0 being the oldest
+	AIHistoryEntry GetEntry(int index)
+	{
+		if (index < 0 || index >= m_Count)
+			return null;
+
+		return m_Slots[(m_Head + index) % m_Capacity];
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Full response of an entry, read from its page file on demand
+	string LoadResponse(AIHistoryEntry entry)
+	{
+		if (!entry)
+			return "";
+
+		if (entry.request)
+			return entry.request.response;
+
+		if (entry.page < 0 || entry.length <= 0)
+			return entry.responsePreview;
+
+		FileHandle file = FileIO.OpenFile(GetPagePath(entry.page), FileMode.READ);
+		if (!file)
+			return entry.responsePreview;
+
+		string record;
+		file.Seek(entry.offset);
+		file.Read(record, entry.length);
+		file.Close();
+
+		string parseError;
+		AIJSONValue root = AIJSONReader.Parse(record, parseError);
+		if (!root)
+			return entry.responsePreview;
+
+		return root.GetString("response", entry.responsePreview);
+	}
+
+	//-----------------------------------------------------------------------------
+	void Clear()
+	{
+		array<ref AIHistoryEntry> entries = GetEntries();
+		foreach (AIHistoryEntry entry : entries)
+		{
+			if (entry.page >= 0)
+				FileIO.DeleteFile(GetPagePath(entry.page));
+		}
+
+		m_Slots = {};
+		m_Slots.Resize(m_Capacity);
+		m_Head = 0;
+		m_Count = 0;
+		m_PageRefs.Clear();
+
+		FileIO.DeleteFile(m_IndexPath);
+		m_IndexLines = 0;
+		m_CurrentPage++;
+		m_CurrentPageEntries = 0;
+		m_CurrentPageBytes = 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void Push(AIHistoryEntry entry)
+	{
+		if (m_Count < m_Capacity)
+		{
+			m_Slots[(m_Head + m_Count) % m_Capacity] = entry;
+			m_Count++;
+			return;
+		}
+
+		AIHistoryEntry oldest = m_Slots[m_Head];
+		m_Slots[m_Head] = entry;
+		m_Head = (m_Head + 1) % m_Capacity;
+		ReleasePage(oldest);
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void RetainPage(int page)
+	{
+		if (page >= 0)
+			m_PageRefs.Set(page, m_PageRefs.Get(page) + 1);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Drop an evicted entry's reference and delete its page once unused
+	protected void ReleasePage(AIHistoryEntry evicted)
+	{
+		if (!evicted || evicted.page < 0)
+			return;
+
+		int refs = m_PageRefs.Get(evicted.page) - 1;
+		if (refs > 0 || evicted.page == m_CurrentPage)
+		{
+			m_PageRefs.Set(evicted.page, Math.Max(0, refs));
+			return;
+		}
+
+		m_PageRefs.Remove(evicted.page);
+		FileIO.DeleteFile(GetPagePath(evicted.page));
+	}
+
+	//-----------------------------------------------------------------------------
+	protected AIHistoryEntry Find(string requestId)
+	{
+		// Newest first, completions almost always concern recent requests
+		for (int i = m_Count - 1; i >= 0; i--)
+		{
+			AIHistoryEntry entry = m_Slots[(m_Head + i) % m_Capacity];
+			if (entry.requestId == requestId)
+				return entry;
+		}
+
+		return null;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected string GetPagePath(int page)
+	{
+		return m_Directory + "/page_" + page + ".jsonl";
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void EnsureDirectory()
+	{
+		if (!FileIO.FileExists(m_Directory))
+			FileIO.MakeDirectory(m_Directory);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Append the full response record to the current page
+	protected void AppendResponse(AIHistoryEntry entry, string response)
+	{
+		if (m_CurrentPageEntries >= ENTRIES_PER_PAGE)
+		{
+			// Sealing the page; it may already have lost all its entries
+			if (m_PageRefs.Get(m_CurrentPage) <= 0)
+			{
+				m_PageRefs.Remove(m_CurrentPage);
+				FileIO.DeleteFile(GetPagePath(m_CurrentPage));
+			}
+
+			m_CurrentPage++;
+			m_CurrentPageEntries = 0;
+			m_CurrentPageBytes = 0;
+		}
+
+		EnsureDirectory();
+
+		string record = "{\"requestId\": \"" + AIJSONUtils.EscapeString(entry.requestId) + "\", \"response\": \"" + AIJSONUtils.EscapeString(response) + "\"}\n";
+
+		FileHandle file = FileIO.OpenFile(GetPagePath(m_CurrentPage), FileMode.APPEND);
+		if (!file)
+			return;
+
+		file.Write(record);
+		file.Close();
+
+		entry.page = m_CurrentPage;
+		entry.offset = m_CurrentPageBytes;
+		entry.length = record.Length();
+
+		m_CurrentPageEntries++;
+		m_CurrentPageBytes += entry.length;
+		RetainPage(entry.page);
+	}
+
+	//-----------------------------------------------------------------------------
+	protected string BuildIndexLine(AIHistoryEntry entry)
+	{
+		array<string> pieces = {};
+		pieces.Insert("{\"requestId\": \"" + AIJSONUtils.EscapeString(entry.requestId) + "\"");
+		pieces.Insert(", \"type\": " + entry.type);
+		pieces.Insert(", \"timestamp\": " + entry.timestamp);
+		pieces.Insert(", \"userInput\": \"" + AIJSONUtils.EscapeString(entry.userInput) + "\"");
+		pieces.Insert(", \"isCompleted\": " + (entry.isCompleted ? "true" : "false"));
+		pieces.Insert(", \"error\": \"" + AIJSONUtils.EscapeString(entry.errorMessage) + "\"");
+		pieces.Insert(", \"pollCount\": " + entry.pollCount);
+		pieces.Insert(", \"detectionLatencyMs\": " + entry.detectionLatencyMs);
+		pieces.Insert(", \"responseBytes\": " + entry.responseBytes);
+		pieces.Insert(", \"responseReadMs\": " + entry.responseReadMs);
+		pieces.Insert(", \"estimatedInputTokens\": " + entry.estimatedInputTokens);
+		pieces.Insert(", \"inputTokens\": " + entry.inputTokens);
+		pieces.Insert(", \"outputTokens\": " + entry.outputTokens);
+		pieces.Insert(", \"responsePreview\": \"" + AIJSONUtils.EscapeString(entry.responsePreview) + "\"");
+		pieces.Insert(", \"responseLength\": " + entry.responseLength);
+		pieces.Insert(", \"page\": " + entry.page);
+		pieces.Insert(", \"offset\": " + entry.offset);
+		pieces.Insert(", \"length\": " + entry.length);
+		pieces.Insert("}\n");
+		return AIJSONUtils.JoinStrings(pieces);
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void AppendIndexLine(AIHistoryEntry entry)
+	{
+		EnsureDirectory();
+
+		FileHandle file = FileIO.OpenFile(m_IndexPath, FileMode.APPEND);
+		if (!file)
+			return;
+
+		file.Write(BuildIndexLine(entry));
+		file.Close();
+		m_IndexLines++;
+
+		// The index is append-only; compact it once it holds mostly evicted entries
+		if (m_IndexLines > m_Capacity * 2)
+			RewriteIndex();
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void RewriteIndex()
+	{
+		array<string> lines = {};
+		array<ref AIHistoryEntry> entries = GetEntries();
+		foreach (AIHistoryEntry entry : entries)
+		{
+			if (entry.page >= 0)
+				lines.Insert(BuildIndexLine(entry));
+		}
+
+		AIFileUtils.WriteAll(m_IndexPath, AIJSONUtils.JoinStrings(lines));
+		m_IndexLines = lines.Count();
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Restore summaries from the index; response bodies stay on disk
+	protected void Load()
+	{
+		string content;
+		if (!AIFileUtils.ReadAll(m_IndexPath, content))
+			return;
+
+		array<string> lines = {};
+		content.Split("\n", lines, true);
+
+		foreach (string line : lines)
+		{
+			string parseError;
+			AIJSONValue root = AIJSONReader.Parse(line, parseError);
+			if (!root || !root.IsObject())
+				continue;
+
+			AIHistoryEntry entry = new AIHistoryEntry();
+			entry.requestId = root.GetString("requestId");
+			entry.type = root.GetInt("type");
+			entry.timestamp = root.GetInt("timestamp");
+			entry.userInput = root.GetString("userInput");
+			entry.isCompleted = root.GetBool("isCompleted");
+			entry.errorMessage = root.GetString("error");
+			entry.pollCount = root.GetInt("pollCount");
+			entry.detectionLatencyMs = root.GetInt("detectionLatencyMs", -1);
+			entry.responseBytes = root.GetInt("responseBytes");
+			entry.responseReadMs = root.GetInt("responseReadMs");
+			entry.estimatedInputTokens = root.GetInt("estimatedInputTokens");
+			entry.inputTokens = root.GetInt("inputTokens", -1);
+			entry.outputTokens = root.GetInt("outputTokens", -1);
+			entry.responsePreview = root.GetString("responsePreview");
+			entry.responseLength = root.GetInt("responseLength");
+			entry.page = root.GetInt("page", -1);
+			entry.offset = root.GetInt("offset");
+			entry.length = root.GetInt("length");
+			RetainPage(entry.page);
+			Push(entry);
+
+			m_CurrentPage = Math.Max(m_CurrentPage, entry.page);
+		}
+
+		m_IndexLines = lines.Count();
+
+		// Continue filling the newest page
+		FileHandle page = FileIO.OpenFile(GetPagePath(m_CurrentPage), FileMode.READ);
+		if (page)
+		{
+			m_CurrentPageBytes = page.GetLength();
+			page.Close();
+		}
+
+		// Records are counted in the page itself; entries evicted from or compacted
+		// out of the history still take up their line there
+		m_CurrentPageEntries = 0;
+		string records;
+		if (AIFileUtils.ReadAll(GetPagePath(m_CurrentPage), records))
+		{
+			array<string> recordLines = {};
+			records.Split("\n", recordLines, true);
+			m_CurrentPageEntries = recordLines.Count();
+		}
+
+		if (m_IndexLines > m_Count)
+			RewriteIndex();
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Small inverted index over a history snapshot for the history browser
+//! Maps lower-case words of the input/response previews to entry positions
+class AIHistoryIndex
+{
+	protected static const string WORD_CHARACTERS = "abcdefghijklmnopqrstuvwxyz0123456789_";
+
+	protected ref array<ref AIHistoryEntry> m_Entries;
+	protected ref map<string, ref array<int>> m_Postings;
+
+	//-----------------------------------------------------------------------------
+	void AIHistoryIndex(array<ref AIHistoryEntry> entries)
+	{
+		m_Entries = entries;
+		m_Postings = new map<string, ref array<int>>();
+
+		array<string> tokens = {};
+		for (int i = 0; i < entries.Count(); i++)
+		{
+			AIHistoryEntry entry = entries[i];
+			tokens.Clear();
+			Tokenize(entry.userInput, tokens);
+			Tokenize(entry.responsePreview, tokens);
+			Tokenize(entry.errorMessage, tokens);
+
+			foreach (string token : tokens)
+			{
+				array<int> postings = m_Postings.Get(token);
+				if (!postings)
+				{
+					postings = {};
+					m_Postings.Set(token, postings);
+				}
+
+				// Entries are indexed in order, so a repeat is always the last posting
+				if (postings.IsEmpty() || postings[postings.Count() - 1] != i)
+					postings.Insert(i);
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Split text into lower-case words
+	static void Tokenize(string text, array<string> tokens)
+	{
+		string lower = text;
+		lower.ToLower();
+
+		int length = lower.Length();
+		int start = -1;
+		for (int i = 0; i <= length; i++)
+		{
+			bool isWord = i < length && WORD_CHARACTERS.Contains(lower.Get(i));
+			if (isWord && start == -1)
+			{
+				start = i;
+			}
+			else if (!isWord && start != -1)
+			{
+				tokens.Insert(lower.Substring(start, i - start));
+				start = -1;
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Positions of entries matching every query word (as a prefix) and the type,
+	//! newest first; typeFilter -1 matches all types
+	array<int> Search(string query, int typeFilter)
+	{
+		array<string> queryTokens = {};
+		Tokenize(query, queryTokens);
+
+		// Count, per entry, how many query words it matched
+		array<int> hits = {};
+		hits.Resize(m_Entries.Count());
+
+		for (int t = 0; t < queryTokens.Count(); t++)
+		{
+			string queryToken = queryTokens[t];
+			foreach (string token, array<int> postings : m_Postings)
+			{
+				if (!token.StartsWith(queryToken))
+					continue;
+
+				foreach (int position : postings)
+				{
+					// Only the first matching word of an entry counts for this query word
+					if (hits[position] == t)
+						hits[position] = t + 1;
+				}
+			}
+		}
+
+		array<int> matches = {};
+		for (int i = m_Entries.Count() - 1; i >= 0; i--)
+		{
+			if (hits[i] != queryTokens.Count())
+				continue;
+
+			if (typeFilter != -1 && m_Entries[i].type != typeFilter)
+				continue;
+
+			matches.Insert(i);
+		}
+
+		return matches;
+	}
+}
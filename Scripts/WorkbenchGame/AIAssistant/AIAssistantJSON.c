@@ -0,0 +1,648 @@
+//-----------------------------------------------------------------------------
+//! JSON helpers shared by the AI Assistant core, settings and history code
+//-----------------------------------------------------------------------------
+
+class AIJSONUtils
+{
+	//-----------------------------------------------------------------------------
+	//! Escape text for inclusion in a JSON string literal
+	//! Finds the next escapable character with native IndexOfFrom scans and copies
+	//! the unescaped run before it in one Substring, so the cost stays linear.
+	//! Every control character below 0x20 is escaped; JSON parsers reject them raw
+	static string EscapeString(string value)
+	{
+		array<string> specials = {"\\", "\""};
+		array<string> replacements = {"\\\\", "\\\""};
+		for (int code = 1; code < 0x20; code++)
+		{
+			specials.Insert(code.AsciiToString());
+			replacements.Insert(EscapeControlCharacter(code));
+		}
+
+		// Next occurrence of each special character, -1 once exhausted
+		array<int> nextIndices = {};
+		bool hasSpecial = false;
+		foreach (string special : specials)
+		{
+			int index = value.IndexOf(special);
+			nextIndices.Insert(index);
+			if (index != -1)
+				hasSpecial = true;
+		}
+
+		if (!hasSpecial)
+			return value;
+
+		array<string> pieces = {};
+		int position = 0;
+		while (true)
+		{
+			int nearest = -1;
+			int nearestIndex = -1;
+			for (int i = 0; i < nextIndices.Count(); i++)
+			{
+				int candidate = nextIndices[i];
+				if (candidate != -1 && (nearestIndex == -1 || candidate < nearestIndex))
+				{
+					nearest = i;
+					nearestIndex = candidate;
+				}
+			}
+
+			if (nearest == -1)
+				break;
+
+			if (nearestIndex > position)
+				pieces.Insert(value.Substring(position, nearestIndex - position));
+
+			pieces.Insert(replacements[nearest]);
+			position = nearestIndex + 1;
+			nextIndices[nearest] = value.IndexOfFrom(position, specials[nearest]);
+		}
+
+		int length = value.Length();
+		if (position < length)
+			pieces.Insert(value.Substring(position, length - position));
+
+		return JoinStrings(pieces);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Short escape where JSON has one, \u00XX otherwise
+	protected static string EscapeControlCharacter(int code)
+	{
+		switch (code)
+		{
+			case 8: return "\\b";
+			case 9: return "\\t";
+			case 10: return "\\n";
+			case 12: return "\\f";
+			case 13: return "\\r";
+		}
+
+		string hexDigits = "0123456789abcdef";
+		return "\\u00" + hexDigits.Get(code >> 4) + hexDigits.Get(code & 0xF);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Concatenate pieces by merging neighbours pairwise
+	//! Each byte is copied O(log n) times instead of once per appended piece
+	static string JoinStrings(array<string> pieces)
+	{
+		if (!pieces || pieces.IsEmpty())
+			return "";
+
+		array<string> level = {};
+		level.Copy(pieces);
+
+		while (level.Count() > 1)
+		{
+			array<string> merged = {};
+			for (int i = 0; i < level.Count(); i += 2)
+			{
+				if (i + 1 < level.Count())
+					merged.Insert(level[i] + level[i + 1]);
+				else
+					merged.Insert(level[i]);
+			}
+
+			level = merged;
+		}
+
+		return level[0];
+	}
+}
+
+//-----------------------------------------------------------------------------
+enum AIJSONType
+{
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_OBJECT,
+	JSON_ARRAY
+}
+
+//-----------------------------------------------------------------------------
+//! Parsed JSON value; objects keep their members in a map for O(1) lookup
+class AIJSONValue
+{
+	AIJSONType type;
+	bool boolValue;
+	string stringValue; // string contents, or the raw text of a number
+	ref map<string, ref AIJSONValue> members;
+	ref array<string> memberKeys; // member names in document order
+	ref array<ref AIJSONValue> elements;
+
+	void AIJSONValue(AIJSONType valueType = AIJSONType.JSON_NULL)
+	{
+		type = valueType;
+		boolValue = false;
+		stringValue = "";
+
+		if (type == AIJSONType.JSON_OBJECT)
+		{
+			members = new map<string, ref AIJSONValue>();
+			memberKeys = {};
+		}
+		else if (type == AIJSONType.JSON_ARRAY)
+		{
+			elements = {};
+		}
+	}
+
+	bool IsObject() { return type == AIJSONType.JSON_OBJECT; }
+	bool IsArray() { return type == AIJSONType.JSON_ARRAY; }
+	bool IsString() { return type == AIJSONType.JSON_STRING; }
+	bool IsNull() { return type == AIJSONType.JSON_NULL; }
+
+	//-----------------------------------------------------------------------------
+	void SetMember(string key, AIJSONValue value)
+	{
+		if (!members.Contains(key))
+			memberKeys.Insert(key);
+
+		members.Set(key, value);
+	}
+
+	//-----------------------------------------------------------------------------
+	bool Has(string key)
+	{
+		return members && members.Contains(key);
+	}
+
+	//-----------------------------------------------------------------------------
+	AIJSONValue Get(string key)
+	{
+		if (!members)
+			return null;
+
+		return members.Get(key);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Value as text: string contents, raw number text or true/false
+	string AsString()
+	{
+		if (type == AIJSONType.JSON_BOOL)
+		{
+			if (boolValue)
+				return "true";
+			return "false";
+		}
+
+		return stringValue;
+	}
+
+	float AsFloat() { return stringValue.ToFloat(); }
+	int AsInt() { return stringValue.ToInt(); }
+
+	//-----------------------------------------------------------------------------
+	string GetString(string key, string defaultValue = "")
+	{
+		AIJSONValue value = Get(key);
+		if (!value || value.IsNull() || value.IsObject() || value.IsArray())
+			return defaultValue;
+
+		return value.AsString();
+	}
+
+	//-----------------------------------------------------------------------------
+	bool GetBool(string key, bool defaultValue = false)
+	{
+		AIJSONValue value = Get(key);
+		if (!value || value.type != AIJSONType.JSON_BOOL)
+			return defaultValue;
+
+		return value.boolValue;
+	}
+
+	//-----------------------------------------------------------------------------
+	float GetFloat(string key, float defaultValue = 0)
+	{
+		AIJSONValue value = Get(key);
+		if (!value || value.type != AIJSONType.JSON_NUMBER)
+			return defaultValue;
+
+		return value.AsFloat();
+	}
+
+	//-----------------------------------------------------------------------------
+	int GetInt(string key, int defaultValue = 0)
+	{
+		AIJSONValue value = Get(key);
+		if (!value || value.type != AIJSONType.JSON_NUMBER)
+			return defaultValue;
+
+		return value.AsInt();
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Single-pass JSON reader
+//! Tokenizes the document once into an AIJSONValue tree. String runs without
+//! escapes are located with native IndexOfFrom scans and copied in one piece.
+class AIJSONReader
+{
+	protected static const int MAX_DEPTH = 64;
+
+	protected string m_Text;
+	protected int m_Length;
+	protected int m_Position;
+	protected int m_Depth;
+	protected string m_Error;
+	//! Next backslash at or after the last string scanned, -1 once none are left;
+	//! shared across strings so escape-free documents are scanned for it only once
+	protected int m_NextEscape;
+
+	//-----------------------------------------------------------------------------
+	//! Parse a document; returns null and fills error when it is not valid JSON
+	static AIJSONValue Parse(string text, out string error)
+	{
+		AIJSONReader reader = new AIJSONReader(text);
+		AIJSONValue root = reader.ParseDocument();
+		error = reader.GetError();
+		return root;
+	}
+
+	//-----------------------------------------------------------------------------
+	void AIJSONReader(string text)
+	{
+		m_Text = text;
+		m_Length = text.Length();
+		m_Position = 0;
+		m_Depth = 0;
+		m_Error = "";
+		m_NextEscape = text.IndexOf("\\");
+	}
+
+	//-----------------------------------------------------------------------------
+	string GetError()
+	{
+		return m_Error;
+	}
+
+	//-----------------------------------------------------------------------------
+	AIJSONValue ParseDocument()
+	{
+		AIJSONValue root = ParseValue();
+		if (!root)
+			return null;
+
+		SkipWhitespace();
+		if (m_Position < m_Length)
+			return Fail("Unexpected trailing content");
+
+		return root;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected AIJSONValue Fail(string message)
+	{
+		if (m_Error.IsEmpty())
+			m_Error = message + " at offset " + m_Position;
+
+		return null;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected void SkipWhitespace()
+	{
+		while (m_Position < m_Length)
+		{
+			string ch = m_Text.Get(m_Position);
+			if (ch != " " && ch != "\n" && ch != "\r" && ch != "\t")
+				return;
+
+			m_Position++;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	protected AIJSONValue ParseValue()
+	{
+		SkipWhitespace();
+		if (m_Position >= m_Length)
+			return Fail("Unexpected end of document");
+
+		string ch = m_Text.Get(m_Position);
+		switch (ch)
+		{
+			case "{":
+				return ParseObject();
+
+			case "[":
+				return ParseArray();
+
+			case "\"":
+			{
+				string text;
+				if (!ParseString(text))
+					return null;
+
+				AIJSONValue stringValue = new AIJSONValue(AIJSONType.JSON_STRING);
+				stringValue.stringValue = text;
+				return stringValue;
+			}
+
+			case "t":
+				return ParseLiteral("true", AIJSONType.JSON_BOOL, true);
+
+			case "f":
+				return ParseLiteral("false", AIJSONType.JSON_BOOL, false);
+
+			case "n":
+				return ParseLiteral("null", AIJSONType.JSON_NULL, false);
+		}
+
+		return ParseNumber();
+	}
+
+	//-----------------------------------------------------------------------------
+	protected AIJSONValue ParseObject()
+	{
+		if (++m_Depth > MAX_DEPTH)
+			return Fail("Nesting too deep");
+
+		AIJSONValue objectValue = new AIJSONValue(AIJSONType.JSON_OBJECT);
+		m_Position++; // {
+
+		SkipWhitespace();
+		if (m_Position < m_Length && m_Text.Get(m_Position) == "}")
+		{
+			m_Position++;
+			m_Depth--;
+			return objectValue;
+		}
+
+		while (true)
+		{
+			SkipWhitespace();
+			if (m_Position >= m_Length || m_Text.Get(m_Position) != "\"")
+				return Fail("Expected object key");
+
+			string key;
+			if (!ParseString(key))
+				return null;
+
+			SkipWhitespace();
+			if (m_Position >= m_Length || m_Text.Get(m_Position) != ":")
+				return Fail("Expected ':' after object key");
+
+			m_Position++;
+
+			AIJSONValue memberValue = ParseValue();
+			if (!memberValue)
+				return null;
+
+			objectValue.SetMember(key, memberValue);
+
+			SkipWhitespace();
+			if (m_Position >= m_Length)
+				return Fail("Unterminated object");
+
+			string separator = m_Text.Get(m_Position);
+			m_Position++;
+
+			if (separator == "}")
+				break;
+
+			if (separator != ",")
+				return Fail("Expected ',' or '}' in object");
+		}
+
+		m_Depth--;
+		return objectValue;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected AIJSONValue ParseArray()
+	{
+		if (++m_Depth > MAX_DEPTH)
+			return Fail("Nesting too deep");
+
+		AIJSONValue arrayValue = new AIJSONValue(AIJSONType.JSON_ARRAY);
+		m_Position++; // [
+
+		SkipWhitespace();
+		if (m_Position < m_Length && m_Text.Get(m_Position) == "]")
+		{
+			m_Position++;
+			m_Depth--;
+			return arrayValue;
+		}
+
+		while (true)
+		{
+			AIJSONValue element = ParseValue();
+			if (!element)
+				return null;
+
+			arrayValue.elements.Insert(element);
+
+			SkipWhitespace();
+			if (m_Position >= m_Length)
+				return Fail("Unterminated array");
+
+			string separator = m_Text.Get(m_Position);
+			m_Position++;
+
+			if (separator == "]")
+				break;
+
+			if (separator != ",")
+				return Fail("Expected ',' or ']' in array");
+		}
+
+		m_Depth--;
+		return arrayValue;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Decode a string literal starting at the opening quote
+	protected bool ParseString(out string value)
+	{
+		value = "";
+		m_Position++; // opening quote
+
+		array<string> pieces = {};
+		int nextQuote = m_Text.IndexOfFrom(m_Position, "\"");
+		if (m_NextEscape != -1 && m_NextEscape < m_Position)
+			m_NextEscape = m_Text.IndexOfFrom(m_Position, "\\");
+
+		while (true)
+		{
+			if (nextQuote == -1)
+			{
+				Fail("Unterminated string");
+				return false;
+			}
+
+			// No escape before the closing quote: copy the rest in one go
+			if (m_NextEscape == -1 || nextQuote < m_NextEscape)
+			{
+				if (nextQuote > m_Position)
+					pieces.Insert(m_Text.Substring(m_Position, nextQuote - m_Position));
+
+				m_Position = nextQuote + 1;
+				value = AIJSONUtils.JoinStrings(pieces);
+				return true;
+			}
+
+			if (m_NextEscape > m_Position)
+				pieces.Insert(m_Text.Substring(m_Position, m_NextEscape - m_Position));
+
+			m_Position = m_NextEscape + 1;
+			if (m_Position >= m_Length)
+			{
+				Fail("Unterminated escape sequence");
+				return false;
+			}
+
+			string escaped = m_Text.Get(m_Position);
+			m_Position++;
+
+			switch (escaped)
+			{
+				case "\"": pieces.Insert("\""); break;
+				case "\\": pieces.Insert("\\"); break;
+				case "/": pieces.Insert("/"); break;
+				case "n": pieces.Insert("\n"); break;
+				case "r": pieces.Insert("\r"); break;
+				case "t": pieces.Insert("\t"); break;
+				case "b": pieces.Insert(EncodeUTF8(8)); break;
+				case "f": pieces.Insert(EncodeUTF8(12)); break;
+				case "u":
+				{
+					string decoded;
+					if (!ParseUnicodeEscape(decoded))
+						return false;
+
+					pieces.Insert(decoded);
+					break;
+				}
+				default:
+					Fail("Invalid escape sequence");
+					return false;
+			}
+
+			// Quotes and backslashes consumed by the escape invalidate the cached positions
+			if (nextQuote < m_Position)
+				nextQuote = m_Text.IndexOfFrom(m_Position, "\"");
+
+			m_NextEscape = m_Text.IndexOfFrom(m_Position, "\\");
+		}
+
+		return false;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Decode \uXXXX (and surrogate pairs) into UTF-8; position is just past the 'u'
+	protected bool ParseUnicodeEscape(out string decoded)
+	{
+		decoded = "";
+
+		int codePoint;
+		if (!ReadHex4(codePoint))
+			return false;
+
+		// High surrogate followed by \uDC00-\uDFFF forms one supplementary code point
+		if (codePoint >= 0xD800 && codePoint <= 0xDBFF && m_Position + 6 <= m_Length && m_Text.Substring(m_Position, 2) == "\\u")
+		{
+			int resume = m_Position;
+			m_Position += 2;
+
+			int lowSurrogate;
+			if (ReadHex4(lowSurrogate) && lowSurrogate >= 0xDC00 && lowSurrogate <= 0xDFFF)
+				codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+			else
+				m_Position = resume;
+		}
+
+		decoded = EncodeUTF8(codePoint);
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected bool ReadHex4(out int value)
+	{
+		value = 0;
+		if (m_Position + 4 > m_Length)
+		{
+			Fail("Truncated unicode escape");
+			return false;
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			int digit = "0123456789abcdef".IndexOf(m_Text.Get(m_Position + i));
+			if (digit == -1)
+				digit = "0123456789ABCDEF".IndexOf(m_Text.Get(m_Position + i));
+
+			if (digit == -1)
+			{
+				Fail("Invalid unicode escape");
+				return false;
+			}
+
+			value = value * 16 + digit;
+		}
+
+		m_Position += 4;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Enforce strings are UTF-8 byte strings
+	protected static string EncodeUTF8(int codePoint)
+	{
+		if (codePoint < 0x80)
+			return codePoint.AsciiToString();
+
+		if (codePoint < 0x800)
+			return ByteToString(0xC0 | (codePoint >> 6)) + ByteToString(0x80 | (codePoint & 0x3F));
+
+		if (codePoint < 0x10000)
+			return ByteToString(0xE0 | (codePoint >> 12)) + ByteToString(0x80 | ((codePoint >> 6) & 0x3F)) + ByteToString(0x80 | (codePoint & 0x3F));
+
+		return ByteToString(0xF0 | (codePoint >> 18)) + ByteToString(0x80 | ((codePoint >> 12) & 0x3F)) + ByteToString(0x80 | ((codePoint >> 6) & 0x3F)) + ByteToString(0x80 | (codePoint & 0x3F));
+	}
+
+	//-----------------------------------------------------------------------------
+	protected static string ByteToString(int value)
+	{
+		return value.AsciiToString();
+	}
+
+	//-----------------------------------------------------------------------------
+	protected AIJSONValue ParseLiteral(string literal, AIJSONType literalType, bool boolValue)
+	{
+		int literalLength = literal.Length();
+		if (m_Position + literalLength > m_Length || m_Text.Substring(m_Position, literalLength) != literal)
+			return Fail("Invalid literal");
+
+		m_Position += literalLength;
+
+		AIJSONValue value = new AIJSONValue(literalType);
+		value.boolValue = boolValue;
+		return value;
+	}
+
+	//-----------------------------------------------------------------------------
+	protected AIJSONValue ParseNumber()
+	{
+		int start = m_Position;
+		while (m_Position < m_Length && "0123456789+-.eE".IndexOf(m_Text.Get(m_Position)) != -1)
+		{
+			m_Position++;
+		}
+
+		if (m_Position == start)
+			return Fail("Unexpected character");
+
+		AIJSONValue value = new AIJSONValue(AIJSONType.JSON_NUMBER);
+		value.stringValue = m_Text.Substring(start, m_Position - start);
+		return value;
+	}
+}
@@ -0,0 +1,271 @@
+//-----------------------------------------------------------------------------
+//! Prompt assembly for the AI Assistant
+//! Keeps prompts within an input-token budget by trimming context sections in
+//! priority order
+//-----------------------------------------------------------------------------
+
+//! Fast local token estimate, no tokenizer tables needed
+//! Provider tokenizers average roughly 3.5 bytes per token on code and English
+class AITokenEstimator
+{
+	//-----------------------------------------------------------------------------
+	static int Estimate(string text)
+	{
+		return (text.Length() * 2 + 6) / 7;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Characters that fit into the given number of tokens
+	static int CharsForTokens(int tokens)
+	{
+		return Math.Max(0, tokens) * 7 / 2;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Which part of an oversized section survives trimming
+enum AIPromptTrim
+{
+	KEEP_HEAD,
+	KEEP_TAIL,
+	KEEP_CENTER
+}
+
+//-----------------------------------------------------------------------------
+class AIPromptSection
+{
+	string header;
+	string content;
+	//! Lower values are filled first; required sections always go in whole
+	int priority;
+	bool required;
+	AIPromptTrim trim;
+	string rendered;
+}
+
+//-----------------------------------------------------------------------------
+//! Builds a prompt from required text and optional context sections
+//! System text is a stable preamble sent separately from the prompt so providers
+//! can cache it; it is always kept and counts against the budget. Required text
+//! (instructions, the user's request) is always kept. Context
+//! sections are then granted the remaining budget by priority; a section that
+//! does not fit is trimmed at line boundaries, and dropped when less than
+//! MIN_SECTION_TOKENS would remain. Sections keep their insertion order in the
+//! final prompt.
+class AIPromptBuilder
+{
+	protected static const int MIN_SECTION_TOKENS = 64;
+	protected static const string TRIM_MARKER = "// ... trimmed to fit the prompt budget ...\n";
+
+	protected int m_TokenBudget;
+	protected ref array<ref AIPromptSection> m_Sections;
+	protected ref array<string> m_SystemPieces;
+	protected string m_SystemPrompt;
+	protected int m_EstimatedTokens;
+	protected int m_TrimmedTokens;
+
+	//-----------------------------------------------------------------------------
+	void AIPromptBuilder(int tokenBudget)
+	{
+		m_TokenBudget = tokenBudget;
+		m_Sections = {};
+		m_SystemPieces = {};
+		m_SystemPrompt = "";
+		m_EstimatedTokens = 0;
+		m_TrimmedTokens = 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Stable preamble; must not depend on the request so it stays cacheable
+	void AddSystemText(string text)
+	{
+		m_SystemPieces.Insert(text);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Text that is always included as-is
+	void AddText(string text)
+	{
+		AIPromptSection section = new AIPromptSection();
+		section.content = text;
+		section.required = true;
+		m_Sections.Insert(section);
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Optional context, trimmed or dropped when the budget runs out
+	void AddContext(string header, string content, int priority, AIPromptTrim trim)
+	{
+		if (content.IsEmpty())
+			return;
+
+		AIPromptSection section = new AIPromptSection();
+		section.header = header;
+		section.content = content;
+		section.priority = priority;
+		section.required = false;
+		section.trim = trim;
+		m_Sections.Insert(section);
+	}
+
+	//-----------------------------------------------------------------------------
+	string Build()
+	{
+		m_TrimmedTokens = 0;
+
+		m_SystemPrompt = AIJSONUtils.JoinStrings(m_SystemPieces);
+		int systemTokens = AITokenEstimator.Estimate(m_SystemPrompt);
+		int remaining = m_TokenBudget - systemTokens;
+		array<AIPromptSection> optional = {};
+
+		foreach (AIPromptSection section : m_Sections)
+		{
+			if (section.required)
+			{
+				section.rendered = section.content;
+				remaining -= AITokenEstimator.Estimate(section.rendered);
+				continue;
+			}
+
+			// Insertion sort by priority; there are only a handful of sections
+			int index = optional.Count();
+			while (index > 0 && optional[index - 1].priority > section.priority)
+			{
+				index--;
+			}
+
+			optional.InsertAt(section, index);
+		}
+
+		foreach (AIPromptSection contextSection : optional)
+		{
+			int headerTokens = AITokenEstimator.Estimate(contextSection.header);
+			int contentTokens = AITokenEstimator.Estimate(contextSection.content);
+
+			if (headerTokens + contentTokens <= remaining)
+			{
+				contextSection.rendered = contextSection.header + contextSection.content + "\n\n";
+				remaining -= headerTokens + contentTokens;
+				continue;
+			}
+
+			int available = remaining - headerTokens - AITokenEstimator.Estimate(TRIM_MARKER);
+			if (available < MIN_SECTION_TOKENS)
+			{
+				contextSection.rendered = "";
+				m_TrimmedTokens += contentTokens;
+				continue;
+			}
+
+			string trimmed = TrimToChars(contextSection.content, AITokenEstimator.CharsForTokens(available), contextSection.trim);
+			contextSection.rendered = contextSection.header + trimmed + "\n" + TRIM_MARKER + "\n";
+
+			int keptTokens = AITokenEstimator.Estimate(trimmed);
+			m_TrimmedTokens += contentTokens - keptTokens;
+			remaining -= headerTokens + keptTokens;
+		}
+
+		array<string> pieces = {};
+		foreach (AIPromptSection renderedSection : m_Sections)
+		{
+			if (!renderedSection.rendered.IsEmpty())
+				pieces.Insert(renderedSection.rendered);
+		}
+
+		string prompt = AIJSONUtils.JoinStrings(pieces);
+		m_EstimatedTokens = systemTokens + AITokenEstimator.Estimate(prompt);
+		return prompt;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! System preamble of the last built prompt
+	string GetSystemPrompt()
+	{
+		return m_SystemPrompt;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Estimated input tokens of the last built prompt, system preamble included
+	int GetEstimatedTokens()
+	{
+		return m_EstimatedTokens;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Estimated context tokens left out of the last built prompt
+	int GetTrimmedTokens()
+	{
+		return m_TrimmedTokens;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Cut text to at most maxChars, snapping to whole lines where possible
+	static string TrimToChars(string text, int maxChars, AIPromptTrim trim)
+	{
+		int length = text.Length();
+		if (length <= maxChars)
+			return text;
+
+		int start = 0;
+		if (trim == AIPromptTrim.KEEP_TAIL)
+			start = length - maxChars;
+		else if (trim == AIPromptTrim.KEEP_CENTER)
+			start = (length - maxChars) / 2;
+
+		string window = text.Substring(start, maxChars);
+
+		// Drop the partial first line unless the window starts the text
+		if (start > 0)
+		{
+			int firstBreak = window.IndexOf("\n");
+			if (firstBreak != -1 && firstBreak < window.Length() - 1)
+				window = window.Substring(firstBreak + 1, window.Length() - firstBreak - 1);
+		}
+
+		// Drop the partial last line unless the window ends the text
+		if (start + maxChars < length)
+		{
+			int lastBreak = window.LastIndexOf("\n");
+			if (lastBreak > 0)
+				window = window.Substring(0, lastBreak);
+		}
+
+		return window;
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Declaration and members of the class enclosing offset, up to offset
+	//! Classes are located with the brace-aware AICodeScanner, so a class that
+	//! closed before offset, or "class" inside a comment, is not taken for it
+	static string FindEnclosingClass(string script, int offset)
+	{
+		if (offset <= 0)
+			return "";
+
+		array<ref AICodeSymbol> symbols = {};
+		AICodeScanner.Scan(script, "", symbols);
+
+		foreach (AICodeSymbol symbol : symbols)
+		{
+			if (symbol.kind == AICodeSymbolKind.CLASS && symbol.start < offset && offset < symbol.start + symbol.length)
+				return script.Substring(symbol.start, offset - symbol.start);
+		}
+
+		return "";
+	}
+
+	//-----------------------------------------------------------------------------
+	//! Leading comments and declarations before the first class of a script
+	//! A script without classes has no header; all of it would duplicate the selection
+	static string ExtractFileHeader(string script)
+	{
+		int firstClass = script.IndexOf("\nclass ");
+		if (script.IndexOf("class ") == 0)
+			return "";
+
+		if (firstClass == -1)
+			return "";
+
+		return script.Substring(0, firstClass + 1);
+	}
+}
@@ -10,10 +10,29 @@ enum AIServiceProvider
 	CUSTOM_ENDPOINT
 }
 
+//! Receives the JSON key of a changed setting; an empty key means all settings changed
+void AISettingChangedMethod(string key);
+typedef func AISettingChangedMethod;
+typedef ScriptInvokerBase<AISettingChangedMethod> AISettingChangedInvoker;
+
 class AIAssistantSettings
 {
+	//! Version written to schema_version; files without one are version 1
+	static const int SETTINGS_SCHEMA_VERSION = 6;
+	//! Changes within this window are written together
+	protected static const int SAVE_DEBOUNCE_MS = 500;
+	//! Limits of max_history_entries, shared by the parser, the setter and validation
+	protected static const int MIN_HISTORY_ENTRIES = 1;
+	protected static const int MAX_HISTORY_ENTRIES = 1000;
+	
 	protected string m_ConfigPath;
+	protected string m_ConfigJournalPath;
 	protected bool m_IsConfigured;
+	protected int m_LoadedSchemaVersion;
+	protected ref array<string> m_ValidationReport;
+	protected ref set<string> m_DirtyFields;
+	protected bool m_IsSaveScheduled;
+	protected ref AISettingChangedInvoker m_OnSettingChanged;
 	
 // API Settings
 protected AIServiceProvider m_ServiceProvider;
@@ -22,15 +41,27 @@ protected string m_CustomEndpoint;
 protected string m_ModelName;
 protected float m_Temperature;
 protected int m_MaxTokens;
-protected string m_RequestFilePath;
-protected string m_ResponseFilePath;
+protected int m_PromptTokenBudget;
+protected string m_SpoolDirectory;
+protected int m_ResponseTimeoutMs;
+protected int m_MaxPollIntervalMs;
+	//! Local model (Ollama) context window and CPU threads; 0 keeps the bridge default
+	protected int m_LocalContextTokens;
+	protected int m_LocalThreads;
 	
 	// Behavior Settings
 	protected bool m_AutoInsertCode;
 	protected bool m_ShowConfirmationDialogs;
 	protected bool m_SaveRequestHistory;
 	protected int m_MaxHistoryEntries;
+	protected int m_MaxConcurrentRequests;
+	protected bool m_StreamResponses;
 	protected string m_CodeStyle;
+	protected bool m_CodeIndexEnabled;
+	protected string m_CodeIndexRoot;
+	protected int m_CodeIndexTopK;
+	protected int m_BatchParallelism;
+	protected bool m_ProviderBatchEnabled;
 	
 	// UI Settings
 	protected bool m_ShowTooltips;
@@ -40,7 +71,13 @@ protected string m_ResponseFilePath;
 	void AIAssistantSettings()
 	{
 		m_ConfigPath = "$profile:AIAssistantConfig.json";
+		m_ConfigJournalPath = m_ConfigPath + ".tmp";
 		m_IsConfigured = false;
+		m_LoadedSchemaVersion = SETTINGS_SCHEMA_VERSION;
+		m_ValidationReport = {};
+		m_DirtyFields = new set<string>();
+		m_IsSaveScheduled = false;
+		m_OnSettingChanged = new AISettingChangedInvoker();
 		
 		// Default settings
 		m_ServiceProvider = AIServiceProvider.CLAUDE_API;
@@ -49,14 +86,25 @@ m_CustomEndpoint = "";
 m_ModelName = "claude-3-sonnet-20240229";
 m_Temperature = 0.3;
 m_MaxTokens = 4000;
-m_RequestFilePath = "$profile:ai_request.json";
-m_ResponseFilePath = "$profile:ai_response.json";
+m_PromptTokenBudget = 8000;
+m_SpoolDirectory = "$profile:AIAssistantSpool";
+m_ResponseTimeoutMs = 60000;
+m_MaxPollIntervalMs = 1000;
+m_LocalContextTokens = 0;
+m_LocalThreads = 0;
 		
 		m_AutoInsertCode = false;
 		m_ShowConfirmationDialogs = true;
 		m_SaveRequestHistory = true;
 		m_MaxHistoryEntries = 100;
+		m_MaxConcurrentRequests = 3;
+		m_StreamResponses = true;
 		m_CodeStyle = "Standard";
+		m_CodeIndexEnabled = true;
+		m_CodeIndexRoot = "Scripts";
+		m_CodeIndexTopK = 5;
+		m_BatchParallelism = 2;
+		m_ProviderBatchEnabled = false;
 		
 		m_ShowTooltips = true;
 		m_ThemePreference = "Dark";
@@ -69,193 +117,400 @@ UpdateConfiguredState();
 	//! Load settings from file
 	void LoadSettings()
 	{
-		FileHandle file = FileIO.OpenFile(m_ConfigPath, FileMode.READ);
-		if (!file)
+		string jsonContent;
+		AIFileReadStats readStats = new AIFileReadStats();
+		
+		// A complete journal means the last save stopped while rewriting the config
+		bool fromJournal = ReadJournal(jsonContent, readStats);
+		if (!fromJournal && !AIFileUtils.ReadAll(m_ConfigPath, jsonContent, readStats))
 		{
 			// First time setup - save defaults
 			SaveSettings();
 			return;
 		}
 		
-		string jsonContent = "";
-		string line = "";
-		while (file.ReadLine(line) != 0)
-		{
-			jsonContent += line + "\n";
-		}
-		file.Close();
+		PrintFormat("[AI Copilot] Loaded settings (%1 bytes in %2 ms)", readStats.bytes, readStats.elapsedMs);
 		
 if (!jsonContent.IsEmpty())
 {
 ParseSettingsFromJSON(jsonContent);
 UpdateConfiguredState();
 }
+		
+		foreach (string issue : m_ValidationReport)
+		{
+			Print("[AI Copilot] Settings: " + issue, LogLevel.WARNING);
+		}
+		
+		// Finish an interrupted save and rewrite older files in the current layout
+		if (fromJournal || m_LoadedSchemaVersion < SETTINGS_SCHEMA_VERSION)
+			SaveSettings();
 	}
 	
 	//-----------------------------------------------------------------------------
-	//! Save settings to file
+	//! Read the save journal if it exists and holds a complete document
+	protected bool ReadJournal(out string jsonContent, AIFileReadStats readStats)
+	{
+		if (!FileIO.FileExists(m_ConfigJournalPath))
+			return false;
+		
+		string parseError;
+		if (AIFileUtils.ReadAll(m_ConfigJournalPath, jsonContent, readStats) && AIJSONReader.Parse(jsonContent, parseError))
+		{
+			Print("[AI Copilot] Recovering settings from interrupted save", LogLevel.WARNING);
+			return true;
+		}
+		
+		// The crash hit while writing the journal itself; the config is still intact
+		FileIO.DeleteFile(m_ConfigJournalPath);
+		return false;
+	}
+	
+	//-----------------------------------------------------------------------------
+	void ~AIAssistantSettings()
+	{
+		if (m_IsSaveScheduled && GetGame())
+			GetGame().GetCallqueue().Remove(FlushSettings);
+		
+		FlushSettings();
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Save settings to file immediately
+	//! FileIO cannot rename, so the new content is first written to a journal file
+	//! and only removed once the config itself has been rewritten. A crash while
+	//! rewriting the config leaves the journal for LoadSettings to recover from.
 	void SaveSettings()
 	{
 		string jsonContent = GenerateSettingsJSON();
 		
-		FileHandle file = FileIO.OpenFile(m_ConfigPath, FileMode.WRITE);
-		if (file)
+		if (!AIFileUtils.WriteAll(m_ConfigJournalPath, jsonContent))
 		{
-			file.Write(jsonContent);
-			file.Close();
+			Print("[AI Copilot] Failed to write settings journal " + m_ConfigJournalPath, LogLevel.ERROR);
+			return;
 		}
+		
+		if (!AIFileUtils.WriteAll(m_ConfigPath, jsonContent))
+		{
+			Print("[AI Copilot] Failed to write settings " + m_ConfigPath, LogLevel.ERROR);
+			return;
+		}
+		
+		FileIO.DeleteFile(m_ConfigJournalPath);
+		m_DirtyFields.Clear();
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Notified with the JSON key of every setting that changes
+	AISettingChangedInvoker GetOnSettingChanged()
+	{
+		return m_OnSettingChanged;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! True when a setting changed since the last save; empty key checks for any change
+	bool IsDirty(string key = "")
+	{
+		if (key.IsEmpty())
+			return !m_DirtyFields.IsEmpty();
+		
+		return m_DirtyFields.Contains(key) || m_DirtyFields.Contains("");
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Record a change, notify subscribers and schedule a debounced save
+	protected void MarkDirty(string key)
+	{
+		m_DirtyFields.Insert(key);
+		m_OnSettingChanged.Invoke(key);
+		
+		// Restart the debounce window so a burst of setter calls becomes one write
+		if (m_IsSaveScheduled)
+			GetGame().GetCallqueue().Remove(FlushSettings);
+		
+		GetGame().GetCallqueue().CallLater(FlushSettings, SAVE_DEBOUNCE_MS, false);
+		m_IsSaveScheduled = true;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Write pending changes, if any
+	void FlushSettings()
+	{
+		m_IsSaveScheduled = false;
+		
+		if (m_DirtyFields.IsEmpty())
+			return;
+		
+		SaveSettings();
 	}
 	
 	//-----------------------------------------------------------------------------
 	//! Generate JSON from current settings
 	protected string GenerateSettingsJSON()
 	{
-string json = "{\n";
-json += "  \"api_settings\": {\n";
-string providerLabel = EnumToString(typeof(AIServiceProvider), m_ServiceProvider);
-json += "    \"service_provider\": \"" + providerLabel + "\",\n";
-json += "    \"api_key\": \"" + m_APIKey + "\",\n";
-json += "    \"custom_endpoint\": \"" + m_CustomEndpoint + "\",\n";
-json += "    \"model_name\": \"" + m_ModelName + "\",\n";
-json += "    \"temperature\": " + m_Temperature + ",\n";
-json += "    \"max_tokens\": " + m_MaxTokens + ",\n";
-json += "    \"request_file\": \"" + m_RequestFilePath + "\",\n";
-json += "    \"response_file\": \"" + m_ResponseFilePath + "\"\n";
-json += "  },\n";
-		json += "  \"behavior_settings\": {\n";
-		json += "    \"auto_insert_code\": " + (m_AutoInsertCode ? "true" : "false") + ",\n";
-		json += "    \"show_confirmation_dialogs\": " + (m_ShowConfirmationDialogs ? "true" : "false") + ",\n";
-		json += "    \"save_request_history\": " + (m_SaveRequestHistory ? "true" : "false") + ",\n";
-		json += "    \"max_history_entries\": " + m_MaxHistoryEntries + ",\n";
-		json += "    \"code_style\": \"" + m_CodeStyle + "\"\n";
-		json += "  },\n";
-		json += "  \"ui_settings\": {\n";
-		json += "    \"show_tooltips\": " + (m_ShowTooltips ? "true" : "false") + ",\n";
-		json += "    \"theme_preference\": \"" + m_ThemePreference + "\"\n";
-		json += "  }\n";
-		json += "}";
-		
-		return json;
+		array<string> pieces = {};
+		pieces.Insert("{\n");
+		pieces.Insert("  \"schema_version\": " + SETTINGS_SCHEMA_VERSION + ",\n");
+		pieces.Insert("  \"api_settings\": {\n");
+		string providerLabel = EnumToString(typeof(AIServiceProvider), m_ServiceProvider);
+		pieces.Insert("    \"service_provider\": \"" + providerLabel + "\",\n");
+		pieces.Insert("    \"api_key\": \"" + AIJSONUtils.EscapeString(m_APIKey) + "\",\n");
+		pieces.Insert("    \"custom_endpoint\": \"" + AIJSONUtils.EscapeString(m_CustomEndpoint) + "\",\n");
+		pieces.Insert("    \"model_name\": \"" + AIJSONUtils.EscapeString(m_ModelName) + "\",\n");
+		pieces.Insert("    \"temperature\": " + m_Temperature + ",\n");
+		pieces.Insert("    \"max_tokens\": " + m_MaxTokens + ",\n");
+		pieces.Insert("    \"prompt_token_budget\": " + m_PromptTokenBudget + ",\n");
+		pieces.Insert("    \"spool_directory\": \"" + AIJSONUtils.EscapeString(m_SpoolDirectory) + "\",\n");
+		pieces.Insert("    \"response_timeout_ms\": " + m_ResponseTimeoutMs + ",\n");
+		pieces.Insert("    \"max_poll_interval_ms\": " + m_MaxPollIntervalMs + ",\n");
+		pieces.Insert("    \"local_context_tokens\": " + m_LocalContextTokens + ",\n");
+		pieces.Insert("    \"local_threads\": " + m_LocalThreads + "\n");
+		pieces.Insert("  },\n");
+		pieces.Insert("  \"behavior_settings\": {\n");
+		pieces.Insert("    \"auto_insert_code\": " + (m_AutoInsertCode ? "true" : "false") + ",\n");
+		pieces.Insert("    \"show_confirmation_dialogs\": " + (m_ShowConfirmationDialogs ? "true" : "false") + ",\n");
+		pieces.Insert("    \"save_request_history\": " + (m_SaveRequestHistory ? "true" : "false") + ",\n");
+		pieces.Insert("    \"max_history_entries\": " + m_MaxHistoryEntries + ",\n");
+		pieces.Insert("    \"max_concurrent_requests\": " + m_MaxConcurrentRequests + ",\n");
+		pieces.Insert("    \"stream_responses\": " + (m_StreamResponses ? "true" : "false") + ",\n");
+		pieces.Insert("    \"code_style\": \"" + AIJSONUtils.EscapeString(m_CodeStyle) + "\",\n");
+		pieces.Insert("    \"code_index_enabled\": " + (m_CodeIndexEnabled ? "true" : "false") + ",\n");
+		pieces.Insert("    \"code_index_root\": \"" + AIJSONUtils.EscapeString(m_CodeIndexRoot) + "\",\n");
+		pieces.Insert("    \"code_index_top_k\": " + m_CodeIndexTopK + ",\n");
+		pieces.Insert("    \"batch_parallelism\": " + m_BatchParallelism + ",\n");
+		pieces.Insert("    \"provider_batch_enabled\": " + (m_ProviderBatchEnabled ? "true" : "false") + "\n");
+		pieces.Insert("  },\n");
+		pieces.Insert("  \"ui_settings\": {\n");
+		pieces.Insert("    \"show_tooltips\": " + (m_ShowTooltips ? "true" : "false") + ",\n");
+		pieces.Insert("    \"theme_preference\": \"" + AIJSONUtils.EscapeString(m_ThemePreference) + "\"\n");
+		pieces.Insert("  }\n");
+		pieces.Insert("}");
+		
+		return AIJSONUtils.JoinStrings(pieces);
 	}
 	
 	//-----------------------------------------------------------------------------
-	//! Parse settings from JSON (simplified parser)
+	//! Parse settings from JSON
+	//! The document is parsed once and its leaf values collected into a map keyed by
+	//! setting name, so each setting is a single lookup. Values that are missing,
+	//! mistyped or out of range keep their current value and are listed in the
+	//! validation report.
 	protected void ParseSettingsFromJSON(string jsonContent)
 	{
-// Simplified JSON parsing - in production, would use proper JSON parser
-// This is a basic implementation for demonstration
-
-if (jsonContent.Contains("CLAUDE_API"))
-{
-m_ServiceProvider = AIServiceProvider.CLAUDE_API;
-}
-else if (jsonContent.Contains("OPENAI_API"))
-{
-m_ServiceProvider = AIServiceProvider.OPENAI_API;
-}
-else if (jsonContent.Contains("LOCAL_MODEL"))
-{
-m_ServiceProvider = AIServiceProvider.LOCAL_MODEL;
-}
-else if (jsonContent.Contains("CUSTOM_ENDPOINT"))
-{
-m_ServiceProvider = AIServiceProvider.CUSTOM_ENDPOINT;
-}
+		m_ValidationReport.Clear();
 		
-		if (jsonContent.Contains("\"api_key\""))
+		string parseError;
+		AIJSONValue root = AIJSONReader.Parse(jsonContent, parseError);
+		if (!root || !root.IsObject())
 		{
-			int keyStart = jsonContent.IndexOf("\"api_key\": \"") + 12;
-			int keyEnd = jsonContent.IndexOf("\"", keyStart);
-			if (keyEnd > keyStart)
-			{
-				m_APIKey = jsonContent.Substring(keyStart, keyEnd - keyStart);
-			}
+			m_ValidationReport.Insert("Config is not valid JSON (" + parseError + "), defaults kept");
+			return;
 		}
 		
-		if (jsonContent.Contains("\"model_name\""))
+		map<string, AIJSONValue> values = new map<string, AIJSONValue>();
+		CollectSettingValues(root, values);
+		
+		m_LoadedSchemaVersion = 1;
+		AIJSONValue version = TakeSetting(values, "schema_version", AIJSONType.JSON_NUMBER);
+		if (version)
+			m_LoadedSchemaVersion = version.AsInt();
+		
+		if (m_LoadedSchemaVersion > SETTINGS_SCHEMA_VERSION)
+			m_ValidationReport.Insert("Config schema version " + m_LoadedSchemaVersion + " is newer than supported version " + SETTINGS_SCHEMA_VERSION);
+		
+		AIJSONValue value = TakeSetting(values, "service_provider", AIJSONType.JSON_STRING);
+		if (value)
 		{
-			int modelStart = jsonContent.IndexOf("\"model_name\": \"") + 15;
-			int modelEnd = jsonContent.IndexOf("\"", modelStart);
-			if (modelEnd > modelStart)
-			{
-				m_ModelName = jsonContent.Substring(modelStart, modelEnd - modelStart);
-			}
+			int provider = typename.StringToEnum(AIServiceProvider, value.stringValue);
+			if (provider == -1)
+				m_ValidationReport.Insert("Unknown service_provider '" + value.stringValue + "'");
+			else
+				m_ServiceProvider = provider;
 		}
 		
-		if (jsonContent.Contains("\"custom_endpoint\""))
+		value = TakeSetting(values, "api_key", AIJSONType.JSON_STRING);
+		if (value)
+			m_APIKey = value.stringValue;
+		
+		value = TakeSetting(values, "custom_endpoint", AIJSONType.JSON_STRING);
+		if (value)
+			m_CustomEndpoint = value.stringValue;
+		
+		value = TakeSetting(values, "model_name", AIJSONType.JSON_STRING);
+		if (value)
+			m_ModelName = value.stringValue;
+		
+		value = TakeSetting(values, "temperature", AIJSONType.JSON_NUMBER);
+		if (value)
 		{
-			int endpointStart = jsonContent.IndexOf("\"custom_endpoint\": \"") + 20;
-			int endpointEnd = jsonContent.IndexOf("\"", endpointStart);
-			if (endpointEnd > endpointStart)
+			m_Temperature = Math.Clamp(value.AsFloat(), 0.0, 2.0);
+			if (m_Temperature != value.AsFloat())
+				m_ValidationReport.Insert("temperature " + value.stringValue + " clamped to " + m_Temperature);
+		}
+		
+		value = TakeSetting(values, "max_tokens", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_MaxTokens = ReadIntSetting(value, "max_tokens", 64, 60000);
+		
+		value = TakeSetting(values, "prompt_token_budget", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_PromptTokenBudget = ReadIntSetting(value, "prompt_token_budget", 512, 200000);
+		
+		value = TakeSetting(values, "spool_directory", AIJSONType.JSON_STRING);
+		if (value)
+		{
+			if (value.stringValue.IsEmpty())
+				m_ValidationReport.Insert("spool_directory is empty, default kept");
+			else
+				m_SpoolDirectory = value.stringValue;
+		}
+		
+		value = TakeSetting(values, "response_timeout_ms", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_ResponseTimeoutMs = ReadIntSetting(value, "response_timeout_ms", 5000, 600000);
+		
+		value = TakeSetting(values, "max_poll_interval_ms", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_MaxPollIntervalMs = ReadIntSetting(value, "max_poll_interval_ms", 100, 5000);
+		
+		value = TakeSetting(values, "local_context_tokens", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_LocalContextTokens = ReadIntSetting(value, "local_context_tokens", 0, 131072);
+		
+		value = TakeSetting(values, "local_threads", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_LocalThreads = ReadIntSetting(value, "local_threads", 0, 256);
+		
+		value = TakeSetting(values, "auto_insert_code", AIJSONType.JSON_BOOL);
+		if (value)
+			m_AutoInsertCode = value.boolValue;
+		
+		value = TakeSetting(values, "show_confirmation_dialogs", AIJSONType.JSON_BOOL);
+		if (value)
+			m_ShowConfirmationDialogs = value.boolValue;
+		
+		value = TakeSetting(values, "save_request_history", AIJSONType.JSON_BOOL);
+		if (value)
+			m_SaveRequestHistory = value.boolValue;
+		
+		value = TakeSetting(values, "max_history_entries", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_MaxHistoryEntries = ReadIntSetting(value, "max_history_entries", MIN_HISTORY_ENTRIES, MAX_HISTORY_ENTRIES);
+		
+		value = TakeSetting(values, "max_concurrent_requests", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_MaxConcurrentRequests = ReadIntSetting(value, "max_concurrent_requests", 1, 8);
+		
+		value = TakeSetting(values, "stream_responses", AIJSONType.JSON_BOOL);
+		if (value)
+			m_StreamResponses = value.boolValue;
+		
+		value = TakeSetting(values, "code_style", AIJSONType.JSON_STRING);
+		if (value)
+			m_CodeStyle = value.stringValue;
+		
+		value = TakeSetting(values, "code_index_enabled", AIJSONType.JSON_BOOL);
+		if (value)
+			m_CodeIndexEnabled = value.boolValue;
+		
+		value = TakeSetting(values, "code_index_root", AIJSONType.JSON_STRING);
+		if (value)
+		{
+			if (value.stringValue.IsEmpty())
+				m_ValidationReport.Insert("code_index_root is empty, default kept");
+			else
+				m_CodeIndexRoot = value.stringValue;
+		}
+		
+		value = TakeSetting(values, "code_index_top_k", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_CodeIndexTopK = ReadIntSetting(value, "code_index_top_k", 0, 20);
+		
+		value = TakeSetting(values, "batch_parallelism", AIJSONType.JSON_NUMBER);
+		if (value)
+			m_BatchParallelism = ReadIntSetting(value, "batch_parallelism", 1, 16);
+		
+		value = TakeSetting(values, "provider_batch_enabled", AIJSONType.JSON_BOOL);
+		if (value)
+			m_ProviderBatchEnabled = value.boolValue;
+		
+		value = TakeSetting(values, "show_tooltips", AIJSONType.JSON_BOOL);
+		if (value)
+			m_ShowTooltips = value.boolValue;
+		
+		value = TakeSetting(values, "theme_preference", AIJSONType.JSON_STRING);
+		if (value)
+			m_ThemePreference = value.stringValue;
+		
+		// Whatever is left was not consumed by any setting above
+		foreach (string key, AIJSONValue unused : values)
+		{
+			m_ValidationReport.Insert("Unknown setting '" + key + "' ignored");
+		}
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Flatten the top level and its section objects into name -> value
+	protected void CollectSettingValues(AIJSONValue root, map<string, AIJSONValue> values)
+	{
+		foreach (string key : root.memberKeys)
+		{
+			AIJSONValue member = root.Get(key);
+			if (!member.IsObject())
+			{
+				values.Set(key, member);
+				continue;
+			}
+			
+			foreach (string settingKey : member.memberKeys)
 			{
-				m_CustomEndpoint = jsonContent.Substring(endpointStart, endpointEnd - endpointStart);
+				values.Set(settingKey, member.Get(settingKey));
 			}
 		}
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Remove a setting from the map, returning it only if it has the expected type
+	protected AIJSONValue TakeSetting(map<string, AIJSONValue> values, string key, AIJSONType expectedType)
+	{
+		AIJSONValue value = values.Get(key);
+		if (!value)
+			return null;
 		
-// Parse boolean values
-m_AutoInsertCode = jsonContent.Contains("\"auto_insert_code\": true");
-m_ShowConfirmationDialogs = !jsonContent.Contains("\"show_confirmation_dialogs\": false");
-m_SaveRequestHistory = !jsonContent.Contains("\"save_request_history\": false");
-m_ShowTooltips = !jsonContent.Contains("\"show_tooltips\": false");
-
-// Parse numeric values
-if (jsonContent.Contains("\"max_history_entries\":"))
-{
-int numStart = jsonContent.IndexOf("\"max_history_entries\": ") + 24;
-int numEnd = jsonContent.IndexOf(",", numStart);
-if (numEnd == -1) numEnd = jsonContent.IndexOf("}", numStart);
-
-if (numEnd > numStart)
-{
-string numStr = jsonContent.Substring(numStart, numEnd - numStart).Trim();
-m_MaxHistoryEntries = numStr.ToInt();
-}
-}
-
-if (jsonContent.Contains("\"temperature\":"))
-{
-int tempStart = jsonContent.IndexOf("\"temperature\": ") + 15;
-int tempEnd = jsonContent.IndexOf(",", tempStart);
-if (tempEnd == -1) tempEnd = jsonContent.IndexOf("\n", tempStart);
-if (tempEnd == -1) tempEnd = jsonContent.Length();
-
-if (tempEnd > tempStart)
-{
-string tempStr = jsonContent.Substring(tempStart, tempEnd - tempStart).Trim();
-m_Temperature = tempStr.ToFloat();
-}
-}
-
-if (jsonContent.Contains("\"max_tokens\":"))
-{
-int tokensStart = jsonContent.IndexOf("\"max_tokens\": ") + 15;
-int tokensEnd = jsonContent.IndexOf(",", tokensStart);
-if (tokensEnd == -1) tokensEnd = jsonContent.IndexOf("\n", tokensStart);
-if (tokensEnd == -1) tokensEnd = jsonContent.Length();
-
-if (tokensEnd > tokensStart)
-{
-string tokensStr = jsonContent.Substring(tokensStart, tokensEnd - tokensStart).Trim();
-m_MaxTokens = tokensStr.ToInt();
-}
-}
-
-if (jsonContent.Contains("\"request_file\""))
-{
-int reqStart = jsonContent.IndexOf("\"request_file\": \"") + 18;
-int reqEnd = jsonContent.IndexOf("\"", reqStart);
-if (reqEnd > reqStart)
-m_RequestFilePath = jsonContent.Substring(reqStart, reqEnd - reqStart);
-}
-
-if (jsonContent.Contains("\"response_file\""))
-{
-int resStart = jsonContent.IndexOf("\"response_file\": \"") + 19;
-int resEnd = jsonContent.IndexOf("\"", resStart);
-if (resEnd > resStart)
-m_ResponseFilePath = jsonContent.Substring(resStart, resEnd - resStart);
-}
-}
+		values.Remove(key);
+		if (value.type != expectedType)
+		{
+			m_ValidationReport.Insert("Setting '" + key + "' has the wrong type, default kept");
+			return null;
+		}
+		
+		return value;
+	}
+	
+	//-----------------------------------------------------------------------------
+	protected int ReadIntSetting(AIJSONValue value, string key, int minValue, int maxValue)
+	{
+		int number = value.AsInt();
+		int clamped = Math.ClampInt(number, minValue, maxValue);
+		if (clamped != number)
+			m_ValidationReport.Insert(key + " " + number + " clamped to " + clamped);
+		
+		return clamped;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Problems found while loading the config file
+	array<string> GetValidationReport()
+	{
+		return m_ValidationReport;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Schema version of the config file that was loaded
+	int GetLoadedSchemaVersion()
+	{
+		return m_LoadedSchemaVersion;
+	}
 	
 	//-----------------------------------------------------------------------------
 	//! Getters and Setters
@@ -264,32 +519,44 @@ m_ResponseFilePath = jsonContent.Substring(resStart, resEnd - resStart);
 AIServiceProvider GetServiceProvider() { return m_ServiceProvider; }
 void SetServiceProvider(AIServiceProvider provider)
 {
+if (provider == m_ServiceProvider)
+return;
+
 m_ServiceProvider = provider;
 UpdateConfiguredState();
-SaveSettings();
+MarkDirty("service_provider");
 }
 	
 string GetAPIKey() { return m_APIKey; }
 void SetAPIKey(string apiKey)
 {
+if (apiKey == m_APIKey)
+return;
+
 m_APIKey = apiKey;
 UpdateConfiguredState();
-SaveSettings();
+MarkDirty("api_key");
 }
 	
 string GetCustomEndpoint() { return m_CustomEndpoint; }
 void SetCustomEndpoint(string endpoint)
 {
+if (endpoint == m_CustomEndpoint)
+return;
+
 m_CustomEndpoint = endpoint;
 UpdateConfiguredState();
-SaveSettings();
+MarkDirty("custom_endpoint");
 }
 	
 string GetModelName() { return m_ModelName; }
 void SetModelName(string modelName)
 {
+if (modelName == m_ModelName)
+return;
+
 m_ModelName = modelName;
-SaveSettings();
+MarkDirty("model_name");
 }
 
 float GetTemperature() { return m_Temperature; }
@@ -300,8 +567,11 @@ temperature = 0.0;
 if (temperature > 2.0)
 temperature = 2.0;
 
+if (temperature == m_Temperature)
+return;
+
 m_Temperature = temperature;
-SaveSettings();
+MarkDirty("temperature");
 }
 
 int GetMaxTokens() { return m_MaxTokens; }
@@ -312,28 +582,34 @@ maxTokens = 64;
 if (maxTokens > 60000)
 maxTokens = 60000;
 
+if (maxTokens == m_MaxTokens)
+return;
+
 m_MaxTokens = maxTokens;
-SaveSettings();
+MarkDirty("max_tokens");
 }
 
-string GetRequestFilePath() { return m_RequestFilePath; }
-void SetRequestFilePath(string path)
-{
-if (!path.IsEmpty())
+//! Estimated input tokens a prompt may use; context beyond it is trimmed
+int GetPromptTokenBudget() { return m_PromptTokenBudget; }
+void SetPromptTokenBudget(int tokenBudget)
 {
-m_RequestFilePath = path;
-SaveSettings();
-}
+tokenBudget = Math.ClampInt(tokenBudget, 512, 200000);
+if (tokenBudget == m_PromptTokenBudget)
+return;
+
+m_PromptTokenBudget = tokenBudget;
+MarkDirty("prompt_token_budget");
 }
 
-string GetResponseFilePath() { return m_ResponseFilePath; }
-void SetResponseFilePath(string path)
+//! Directory shared with the bridge; holds <id>.req.json / <id>.resp.json pairs
+string GetSpoolDirectory() { return m_SpoolDirectory; }
+void SetSpoolDirectory(string path)
 {
-if (!path.IsEmpty())
-{
-m_ResponseFilePath = path;
-SaveSettings();
-}
+if (path.IsEmpty() || path == m_SpoolDirectory)
+return;
+
+m_SpoolDirectory = path;
+MarkDirty("spool_directory");
 }
 
 string GetServiceIdentifier()
@@ -356,53 +632,205 @@ return "custom";
 return "claude";
 }
 	
+	//! How long the core waits for a bridge response before failing the request
+	int GetResponseTimeoutMs() { return m_ResponseTimeoutMs; }
+	void SetResponseTimeoutMs(int timeoutMs)
+	{
+		timeoutMs = Math.ClampInt(timeoutMs, 5000, 600000);
+		if (timeoutMs == m_ResponseTimeoutMs)
+			return;
+		
+		m_ResponseTimeoutMs = timeoutMs;
+		MarkDirty("response_timeout_ms");
+	}
+	
+	//! Upper bound of the core's adaptive bridge polling interval
+	int GetMaxPollIntervalMs() { return m_MaxPollIntervalMs; }
+	void SetMaxPollIntervalMs(int intervalMs)
+	{
+		intervalMs = Math.ClampInt(intervalMs, 100, 5000);
+		if (intervalMs == m_MaxPollIntervalMs)
+			return;
+		
+		m_MaxPollIntervalMs = intervalMs;
+		MarkDirty("max_poll_interval_ms");
+	}
+	
 	bool GetAutoInsertCode() { return m_AutoInsertCode; }
 	void SetAutoInsertCode(bool autoInsert) 
 	{ 
+		if (autoInsert == m_AutoInsertCode)
+			return;
+		
 		m_AutoInsertCode = autoInsert; 
-		SaveSettings();
+		MarkDirty("auto_insert_code");
 	}
 	
 	bool GetShowConfirmationDialogs() { return m_ShowConfirmationDialogs; }
 	void SetShowConfirmationDialogs(bool showDialogs) 
 	{ 
+		if (showDialogs == m_ShowConfirmationDialogs)
+			return;
+		
 		m_ShowConfirmationDialogs = showDialogs; 
-		SaveSettings();
+		MarkDirty("show_confirmation_dialogs");
 	}
 	
 	bool GetSaveRequestHistory() { return m_SaveRequestHistory; }
 	void SetSaveRequestHistory(bool saveHistory) 
 	{ 
+		if (saveHistory == m_SaveRequestHistory)
+			return;
+		
 		m_SaveRequestHistory = saveHistory; 
-		SaveSettings();
+		MarkDirty("save_request_history");
 	}
 	
 	int GetMaxHistoryEntries() { return m_MaxHistoryEntries; }
 	void SetMaxHistoryEntries(int maxEntries) 
 	{ 
+		maxEntries = Math.ClampInt(maxEntries, MIN_HISTORY_ENTRIES, MAX_HISTORY_ENTRIES);
+		if (maxEntries == m_MaxHistoryEntries)
+			return;
+		
 		m_MaxHistoryEntries = maxEntries; 
-		SaveSettings();
+		MarkDirty("max_history_entries");
+	}
+	
+	int GetMaxConcurrentRequests() { return m_MaxConcurrentRequests; }
+	void SetMaxConcurrentRequests(int maxRequests)
+	{
+		if (maxRequests < 1)
+			maxRequests = 1;
+		if (maxRequests > 8)
+			maxRequests = 8;
+		
+		if (maxRequests == m_MaxConcurrentRequests)
+			return;
+		
+		m_MaxConcurrentRequests = maxRequests;
+		MarkDirty("max_concurrent_requests");
+	}
+	
+	bool GetStreamResponses() { return m_StreamResponses; }
+	void SetStreamResponses(bool streamResponses)
+	{
+		if (streamResponses == m_StreamResponses)
+			return;
+		
+		m_StreamResponses = streamResponses;
+		MarkDirty("stream_responses");
 	}
 	
 	string GetCodeStyle() { return m_CodeStyle; }
 	void SetCodeStyle(string codeStyle) 
 	{ 
+		if (codeStyle == m_CodeStyle)
+			return;
+		
 		m_CodeStyle = codeStyle; 
-		SaveSettings();
+		MarkDirty("code_style");
+	}
+	
+	//! Index the project's scripts and add related definitions to prompts
+	bool GetCodeIndexEnabled() { return m_CodeIndexEnabled; }
+	void SetCodeIndexEnabled(bool enabled)
+	{
+		if (enabled == m_CodeIndexEnabled)
+			return;
+		
+		m_CodeIndexEnabled = enabled;
+		MarkDirty("code_index_enabled");
+	}
+	
+	//! Directory scanned for *.c files, e.g. "Scripts" or "$MyMod:Scripts"
+	string GetCodeIndexRoot() { return m_CodeIndexRoot; }
+	void SetCodeIndexRoot(string root)
+	{
+		if (root.IsEmpty() || root == m_CodeIndexRoot)
+			return;
+		
+		m_CodeIndexRoot = root;
+		MarkDirty("code_index_root");
+	}
+	
+	//! Related definitions offered to each prompt; 0 disables retrieval
+	int GetCodeIndexTopK() { return m_CodeIndexTopK; }
+	void SetCodeIndexTopK(int topK)
+	{
+		topK = Math.ClampInt(topK, 0, 20);
+		if (topK == m_CodeIndexTopK)
+			return;
+		
+		m_CodeIndexTopK = topK;
+		MarkDirty("code_index_top_k");
+	}
+	
+	//! Chunks a batch job keeps in flight at once
+	int GetBatchParallelism() { return m_BatchParallelism; }
+	void SetBatchParallelism(int parallelism)
+	{
+		parallelism = Math.ClampInt(parallelism, 1, 16);
+		if (parallelism == m_BatchParallelism)
+			return;
+		
+		m_BatchParallelism = parallelism;
+		MarkDirty("batch_parallelism");
+	}
+	
+	//! Send batch jobs through the provider's batch API (slower, cheaper)
+	bool GetProviderBatchEnabled() { return m_ProviderBatchEnabled; }
+	void SetProviderBatchEnabled(bool enabled)
+	{
+		if (enabled == m_ProviderBatchEnabled)
+			return;
+		
+		m_ProviderBatchEnabled = enabled;
+		MarkDirty("provider_batch_enabled");
+	}
+	
+	//! Context window (num_ctx) for local models; 0 keeps the bridge default
+	int GetLocalContextTokens() { return m_LocalContextTokens; }
+	void SetLocalContextTokens(int tokens)
+	{
+		tokens = Math.ClampInt(tokens, 0, 131072);
+		if (tokens == m_LocalContextTokens)
+			return;
+		
+		m_LocalContextTokens = tokens;
+		MarkDirty("local_context_tokens");
+	}
+	
+	//! CPU threads (num_thread) for local models; 0 keeps the bridge default
+	int GetLocalThreads() { return m_LocalThreads; }
+	void SetLocalThreads(int threads)
+	{
+		threads = Math.ClampInt(threads, 0, 256);
+		if (threads == m_LocalThreads)
+			return;
+		
+		m_LocalThreads = threads;
+		MarkDirty("local_threads");
 	}
 	
 bool GetShowTooltips() { return m_ShowTooltips; }
 void SetShowTooltips(bool showTooltips)
 {
+if (showTooltips == m_ShowTooltips)
+return;
+
 m_ShowTooltips = showTooltips;
-SaveSettings();
+MarkDirty("show_tooltips");
 }
 
 string GetThemePreference() { return m_ThemePreference; }
 void SetThemePreference(string theme)
 {
+if (theme == m_ThemePreference)
+return;
+
 m_ThemePreference = theme;
-SaveSettings();
+MarkDirty("theme_preference");
 }
 
 protected void UpdateConfiguredState()
@@ -433,20 +861,31 @@ m_CustomEndpoint = "";
 m_ModelName = "claude-3-sonnet-20240229";
 m_Temperature = 0.3;
 m_MaxTokens = 4000;
-m_RequestFilePath = "$profile:ai_request.json";
-m_ResponseFilePath = "$profile:ai_response.json";
+m_PromptTokenBudget = 8000;
+m_SpoolDirectory = "$profile:AIAssistantSpool";
+m_ResponseTimeoutMs = 60000;
+m_MaxPollIntervalMs = 1000;
+m_LocalContextTokens = 0;
+m_LocalThreads = 0;
 
 m_AutoInsertCode = false;
 m_ShowConfirmationDialogs = true;
 m_SaveRequestHistory = true;
 m_MaxHistoryEntries = 100;
+m_MaxConcurrentRequests = 3;
+m_StreamResponses = true;
 m_CodeStyle = "Standard";
+m_CodeIndexEnabled = true;
+m_CodeIndexRoot = "Scripts";
+m_CodeIndexTopK = 5;
+m_BatchParallelism = 2;
+m_ProviderBatchEnabled = false;
 
 m_ShowTooltips = true;
 m_ThemePreference = "Dark";
 
 UpdateConfiguredState();
-SaveSettings();
+MarkDirty("");
 }
 	
 	//-----------------------------------------------------------------------------
@@ -463,12 +902,17 @@ SaveSettings();
 			return false;
 		}
 		
-if (m_MaxHistoryEntries < 0 || m_MaxHistoryEntries > 1000)
+if (m_MaxHistoryEntries < MIN_HISTORY_ENTRIES || m_MaxHistoryEntries > MAX_HISTORY_ENTRIES)
+{
+return false;
+}
+
+if (m_MaxConcurrentRequests < 1 || m_MaxConcurrentRequests > 8)
 {
 return false;
 }
 
-if (m_RequestFilePath.IsEmpty() || m_ResponseFilePath.IsEmpty())
+if (m_SpoolDirectory.IsEmpty())
 {
 return false;
 }
@@ -2,23 +2,174 @@
 //! Type definitions and data structures for AI Assistant
 //-----------------------------------------------------------------------------
 
+//-----------------------------------------------------------------------------
+//! Immutable snapshot of the editor state, captured once when a request is made
+//! Prompt builders read from the snapshot instead of querying the editor again
+class AIRequestContext
+{
+	protected string m_Module;
+	protected string m_ScriptPath;
+	protected string m_Selection;
+	protected string m_ScriptText;
+	protected int m_ResourceCount;
+	protected int m_EntityCount;
+	protected int m_ContentHash;
+	
+	void AIRequestContext(string module, string scriptPath, string selection, string scriptText, int resourceCount, int entityCount)
+	{
+		m_Module = module;
+		m_ScriptPath = scriptPath;
+		m_Selection = selection;
+		m_ScriptText = scriptText;
+		m_ResourceCount = resourceCount;
+		m_EntityCount = entityCount;
+		m_ContentHash = (module + "\n" + scriptPath + "\n" + selection + "\n" + scriptText).Hash();
+	}
+	
+	string GetModule() { return m_Module; }
+	string GetScriptPath() { return m_ScriptPath; }
+	//! Selected code, empty when nothing is selected or selection was not included
+	string GetSelection() { return m_Selection; }
+	//! Content of the script open in the Script Editor
+	string GetScriptText() { return m_ScriptText; }
+	int GetResourceCount() { return m_ResourceCount; }
+	int GetEntityCount() { return m_EntityCount; }
+	//! Hash of module, script and selection; equal contexts hash equal
+	int GetContentHash() { return m_ContentHash; }
+	
+	//-----------------------------------------------------------------------------
+	//! Exact comparison, used to rule out hash collisions
+	bool Equals(AIRequestContext other)
+	{
+		return other && m_ContentHash == other.m_ContentHash && m_Module == other.m_Module && m_ScriptPath == other.m_ScriptPath && m_Selection == other.m_Selection && m_ScriptText == other.m_ScriptText;
+	}
+}
+
 //-----------------------------------------------------------------------------
 //! Represents a request to the AI system
 class AIRequest
 {
+	string requestId;
 	AIRequestType type;
 	string userInput;
-	WorkbenchContext context;
+	ref AIRequestContext context;
 	int timestamp;
 	string response;
 	bool isCompleted;
 	string errorMessage;
+	int pollCount;
+	int detectionLatencyMs;
+	//! Ask the bridge to skip its response cache for this request
+	bool bypassCache;
+	//! Part of a batch job; sent at batch priority and kept out of the history
+	bool isBatch;
+	int responseBytes;
+	int responseReadMs;
+	//! Local estimate of the prompt size, and the counts the provider reported (-1 if unknown)
+	int estimatedInputTokens;
+	int inputTokens;
+	int outputTokens;
+	//! Stable preamble sent as the provider's system prompt, set when the prompt is built
+	string systemPrompt;
 	
 	void AIRequest()
 	{
 		isCompleted = false;
 		response = "";
 		errorMessage = "";
+		pollCount = 0;
+		detectionLatencyMs = -1;
+		bypassCache = false;
+		isBatch = false;
+		responseBytes = 0;
+		responseReadMs = 0;
+		estimatedInputTokens = 0;
+		inputTokens = -1;
+		outputTokens = -1;
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! Key shared by requests that would produce the same prompt
+	string GetDedupeKey()
+	{
+		int contextHash = 0;
+		if (context)
+			contextHash = context.GetContentHash();
+		
+		return string.Format("%1:%2:%3", type, userInput.Hash(), contextHash);
+	}
+	
+	//-----------------------------------------------------------------------------
+	//! True when both requests ask exactly the same thing
+	bool IsSameRequest(AIRequest other)
+	{
+		if (!other || other.type != type || other.userInput != userInput)
+			return false;
+		
+		if (!context || !other.context)
+			return !context && !other.context;
+		
+		return context.Equals(other.context);
+	}
+}
+
+//-----------------------------------------------------------------------------
+//! Bookkeeping for a request handed to the bridge service
+//! Each entry owns its spool files, timeout and service callback
+class AIPendingRequest
+{
+	string requestId;
+	ref AIRequest request;
+	ref AIServiceCallback serviceCallback;
+	string prompt;
+	string requestFilePath;
+	string readyFilePath;
+	string responseFilePath;
+	string streamFilePath;
+	string streamLengthFilePath;
+	int streamOffset;
+	int startTick;
+	int timeoutMs;
+	int pollCount;
+	//! Upper bound on how long the response sat in the spool before the plugin saw it
+	int detectionLatencyMs;
+	int responseBytes;
+	int responseReadMs;
+	int inputTokens;
+	int outputTokens;
+	//! Input tokens the provider served from its prompt cache (-1 if unknown)
+	int cachedInputTokens;
+	//! Local model time spent loading the model vs. evaluating prompt and output (-1 if unknown)
+	int modelLoadMs;
+	int inferenceMs;
+	//! Identical requests submitted while this one was in flight; they share its outcome
+	ref array<ref AIPendingRequest> followers;
+	//! Queue priority, higher starts first (see AIAssistantCore.GetRequestPriority)
+	int priority;
+	//! Sent through the provider's batch API; may take hours and holds no live call
+	bool isProviderBatch;
+	
+	void AIPendingRequest(AIRequest aiRequest, string aiPrompt, AIServiceCallback callback)
+	{
+		request = aiRequest;
+		requestId = aiRequest.requestId;
+		prompt = aiPrompt;
+		serviceCallback = callback;
+		streamOffset = 0;
+		startTick = 0;
+		timeoutMs = 0;
+		pollCount = 0;
+		detectionLatencyMs = -1;
+		responseBytes = 0;
+		responseReadMs = 0;
+		inputTokens = -1;
+		outputTokens = -1;
+		cachedInputTokens = -1;
+		modelLoadMs = -1;
+		inferenceMs = -1;
+		followers = {};
+		priority = 0;
+		isProviderBatch = false;
 	}
 }
 
@@ -31,6 +182,12 @@ class AIResponseCallback
 		// Override in derived classes
 	}
 	
+	//! Streamed text received before the final response
+	void OnPartial(string chunk)
+	{
+		// Override in derived classes
+	}
+	
 	void OnError(string error)
 	{
 		// Override in derived classes
@@ -46,6 +203,12 @@ class AIServiceCallback
 		// Override in derived classes
 	}
 	
+	//! Streamed text received before the final response
+	void OnPartial(string chunk)
+	{
+		// Override in derived classes
+	}
+	
 	void OnError(string error)
 	{
 		// Override in derived classes
@@ -70,6 +233,11 @@ class AICodeGenerationCallback : AIServiceCallback
 		m_UserCallback.OnSuccess(processedCode);
 	}
 	
+	override void OnPartial(string chunk)
+	{
+		m_UserCallback.OnPartial(chunk);
+	}
+	
 	override void OnError(string error)
 	{
 		m_UserCallback.OnError("Code generation failed: " + error);
@@ -122,6 +290,11 @@ class AICodeAnalysisCallback : AIServiceCallback
 		m_UserCallback.OnSuccess(analysisReport);
 	}
 	
+	override void OnPartial(string chunk)
+	{
+		m_UserCallback.OnPartial(chunk);
+	}
+	
 	override void OnError(string error)
 	{
 		m_UserCallback.OnError("Code analysis failed: " + error);
@@ -156,6 +329,11 @@ class AIDebuggingCallback : AIServiceCallback
 		m_UserCallback.OnSuccess(debugReport);
 	}
 	
+	override void OnPartial(string chunk)
+	{
+		m_UserCallback.OnPartial(chunk);
+	}
+	
 	override void OnError(string error)
 	{
 		m_UserCallback.OnError("Debugging assistance failed: " + error);
@@ -191,6 +369,11 @@ class AIDocumentationCallback : AIServiceCallback
 		m_UserCallback.OnSuccess(documentation);
 	}
 	
+	override void OnPartial(string chunk)
+	{
+		m_UserCallback.OnPartial(chunk);
+	}
+	
 	override void OnError(string error)
 	{
 		m_UserCallback.OnError("Documentation generation failed: " + error);
@@ -240,6 +423,11 @@ class AIOptimizationCallback : AIServiceCallback
 		m_UserCallback.OnSuccess(optimizationReport);
 	}
 	
+	override void OnPartial(string chunk)
+	{
+		m_UserCallback.OnPartial(chunk);
+	}
+	
 	override void OnError(string error)
 	{
 		m_UserCallback.OnError("Optimization analysis failed: " + error);
@@ -274,6 +462,11 @@ class AIExplanationCallback : AIServiceCallback
 		m_UserCallback.OnSuccess(explanation);
 	}
 	
+	override void OnPartial(string chunk)
+	{
+		m_UserCallback.OnPartial(chunk);
+	}
+	
 	override void OnError(string error)
 	{
 		m_UserCallback.OnError("Code explanation failed: " + error);
@@ -307,12 +500,44 @@ class AIChatCallback : AIServiceCallback
                 m_UserCallback.OnSuccess(response);
         }
 
+        override void OnPartial(string chunk)
+        {
+                m_UserCallback.OnPartial(chunk);
+        }
+
         override void OnError(string error)
         {
                 m_UserCallback.OnError("Chat request failed: " + error);
         }
 }
 
+//-----------------------------------------------------------------------------
+//! Batch chunk callback; the report gets the response as the model wrote it
+class AIBatchCallback : AIServiceCallback
+{
+	protected AIResponseCallback m_UserCallback;
+	
+	void AIBatchCallback(AIResponseCallback userCallback)
+	{
+		m_UserCallback = userCallback;
+	}
+	
+	override void OnSuccess(string response)
+	{
+		m_UserCallback.OnSuccess(response);
+	}
+	
+	override void OnPartial(string chunk)
+	{
+		m_UserCallback.OnPartial(chunk);
+	}
+	
+	override void OnError(string error)
+	{
+		m_UserCallback.OnError("Batch request failed: " + error);
+	}
+}
+
 //-----------------------------------------------------------------------------
 //! Refactoring assistance callback
 class AIRefactoringCallback : AIServiceCallback
@@ -330,6 +555,11 @@ class AIRefactoringCallback : AIServiceCallback
 		m_UserCallback.OnSuccess(refactoredCode);
 	}
 	
+	override void OnPartial(string chunk)
+	{
+		m_UserCallback.OnPartial(chunk);
+	}
+	
 	override void OnError(string error)
 	{
 		m_UserCallback.OnError("Code refactoring failed: " + error);
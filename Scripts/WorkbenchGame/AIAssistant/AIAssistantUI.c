@@ -13,6 +13,12 @@ class AIAssistantUI
         protected bool m_IsSettingsDialogOpen;
         protected ref array<string> m_RequestTypeLabels;
         protected ref array<AIRequestType> m_RequestTypeValues;
+        //! Most recent request sent from the dialog, offered for cancellation while it runs
+        protected string m_LastRequestId;
+
+        //! History browser page size and summary length
+        protected static const int HISTORY_PAGE_SIZE = 10;
+        protected static const int HISTORY_SUMMARY_LENGTH = 80;
 
         //-----------------------------------------------------------------------------
         void AIAssistantUI(AIAssistantCore aiCore, AIAssistantPlugin plugin)
@@ -67,12 +73,65 @@ inputs.Insert(includeSelectionInput);
 ScriptDialogInputCheckBox insertIntoEditorInput = new ScriptDialogInputCheckBox("Insert generated code into editor", settings.GetAutoInsertCode());
 inputs.Insert(insertIntoEditorInput);
 
+ScriptDialogInputCheckBox bypassCacheInput = new ScriptDialogInputCheckBox("Bypass bridge response cache", false);
+inputs.Insert(bypassCacheInput);
+
+ScriptDialogInputCheckBox historyInput = new ScriptDialogInputCheckBox("Browse request history instead", false);
+inputs.Insert(historyInput);
+
+ScriptDialogInputCheckBox cancelInput;
+if (!m_LastRequestId.IsEmpty() && m_AICore.IsProcessing())
+{
+cancelInput = new ScriptDialogInputCheckBox("Cancel the previous request instead", false);
+inputs.Insert(cancelInput);
+}
+
+// Documentation and analysis can run over a whole folder instead of the selection
+ScriptDialogInputText batchFolderInput = new ScriptDialogInputText("Batch folder (document/analyse every script)", "");
+inputs.Insert(batchFolderInput);
+
+ScriptDialogInputCheckBox stopBatchInput;
+AIBatchJob batchJob = m_AICore.GetBatchJob();
+if (batchJob && batchJob.IsRunning())
+{
+stopBatchInput = new ScriptDialogInputCheckBox("Stop the running batch job instead (" + batchJob.GetFilesDone() + "/" + batchJob.GetFileCount() + " files)", false);
+inputs.Insert(stopBatchInput);
+}
+
 bool confirmed = Workbench.ScriptDialog().Show("AI Copilot", "Send", "Cancel", inputs);
 m_IsMainDialogOpen = false;
 
 if (!confirmed)
 return;
 
+if (historyInput.GetValue())
+{
+ShowRequestHistory();
+return;
+}
+
+if (cancelInput && cancelInput.GetValue())
+{
+if (!m_AICore.CancelRequest(m_LastRequestId))
+ShowMessage("The previous request has already finished.");
+
+m_LastRequestId = "";
+return;
+}
+
+if (stopBatchInput && stopBatchInput.GetValue())
+{
+m_AICore.StopBatchJob();
+return;
+}
+
+string batchFolder = batchFolderInput.GetValue().Trim();
+if (!batchFolder.IsEmpty())
+{
+StartBatchJob(m_RequestTypeValues[typeInput.GetValue()], batchFolder, promptInput.GetValue().Trim());
+return;
+}
+
 string userPrompt = promptInput.GetValue().Trim();
 if (userPrompt.IsEmpty())
 {
@@ -82,15 +141,33 @@ return;
 
                 AIRequestType requestType = m_RequestTypeValues[typeInput.GetValue()];
 
-                if (includeSelectionInput.GetValue())
-                        userPrompt = AppendSelectionContext(userPrompt, context);
-
 if (insertIntoEditorInput.GetValue() != settings.GetAutoInsertCode())
 {
 settings.SetAutoInsertCode(insertIntoEditorInput.GetValue());
 }
 
-                ProcessAIRequest(requestType, userPrompt);
+                ProcessAIRequest(requestType, userPrompt, bypassCacheInput.GetValue(), includeSelectionInput.GetValue());
+        }
+
+        //-----------------------------------------------------------------------------
+        //! Start a batch job; the prompt is optional and is passed as the focus
+        protected void StartBatchJob(AIRequestType requestType, string folder, string instructions)
+        {
+                if (requestType != AIRequestType.DOCUMENTATION && requestType != AIRequestType.CODE_ANALYSIS)
+                {
+                        ShowMessage("Batch folders are supported for \"Document code\" and \"Analyse code\" only.");
+                        return;
+                }
+
+                AIBatchJob batchJob = m_AICore.GetBatchJob();
+                if (batchJob && batchJob.IsRunning())
+                {
+                        ShowMessage("A batch job is already running: " + batchJob.GetStatusText());
+                        return;
+                }
+
+                if (!m_AICore.StartBatchJob(requestType, folder, instructions))
+                        ShowMessage("No scripts found under " + folder + ".");
         }
 
         //-----------------------------------------------------------------------------
@@ -101,21 +178,6 @@ m_RequestTypeLabels = {"General chat", "Generate code", "Analyse code", "Debug c
 m_RequestTypeValues = {AIRequestType.GENERAL_CHAT, AIRequestType.CODE_GENERATION, AIRequestType.CODE_ANALYSIS, AIRequestType.CODE_DEBUGGING, AIRequestType.DOCUMENTATION, AIRequestType.OPTIMIZATION, AIRequestType.EXPLANATION, AIRequestType.REFACTORING};
 }
 
-        //-----------------------------------------------------------------------------
-        //! Append current selection information to the user prompt
-        protected string AppendSelectionContext(string prompt, WorkbenchContext context)
-        {
-                string selection = m_AICore.GetSelectedCode(context);
-                if (selection.IsEmpty())
-                        return prompt;
-
-                string enrichedPrompt = prompt;
-                enrichedPrompt += "\n\n=== Selected Script Context ===\n";
-                enrichedPrompt += selection;
-
-                return enrichedPrompt;
-        }
-
         //-----------------------------------------------------------------------------
         //! Create a simple history preview to show inside the dialog
 //-----------------------------------------------------------------------------
@@ -146,11 +208,32 @@ inputs.Insert(temperatureInput);
 ScriptDialogInputText maxTokensInput = new ScriptDialogInputText("Max tokens", settings.GetMaxTokens().ToString());
 inputs.Insert(maxTokensInput);
 
-ScriptDialogInputText requestFileInput = new ScriptDialogInputText("Request file path", settings.GetRequestFilePath());
-inputs.Insert(requestFileInput);
+ScriptDialogInputText promptBudgetInput = new ScriptDialogInputText("Prompt token budget", settings.GetPromptTokenBudget().ToString());
+inputs.Insert(promptBudgetInput);
+
+ScriptDialogInputText localContextInput = new ScriptDialogInputText("Local model context tokens (0 = default)", settings.GetLocalContextTokens().ToString());
+inputs.Insert(localContextInput);
+
+ScriptDialogInputText localThreadsInput = new ScriptDialogInputText("Local model threads (0 = default)", settings.GetLocalThreads().ToString());
+inputs.Insert(localThreadsInput);
 
-ScriptDialogInputText responseFileInput = new ScriptDialogInputText("Response file path", settings.GetResponseFilePath());
-inputs.Insert(responseFileInput);
+ScriptDialogInputCheckBox codeIndexInput = new ScriptDialogInputCheckBox("Add related project definitions", settings.GetCodeIndexEnabled());
+inputs.Insert(codeIndexInput);
+
+ScriptDialogInputText codeIndexRootInput = new ScriptDialogInputText("Script index root", settings.GetCodeIndexRoot());
+inputs.Insert(codeIndexRootInput);
+
+ScriptDialogInputText codeIndexTopKInput = new ScriptDialogInputText("Related definitions per prompt", settings.GetCodeIndexTopK().ToString());
+inputs.Insert(codeIndexTopKInput);
+
+ScriptDialogInputText batchParallelismInput = new ScriptDialogInputText("Batch chunks in flight", settings.GetBatchParallelism().ToString());
+inputs.Insert(batchParallelismInput);
+
+ScriptDialogInputCheckBox providerBatchInput = new ScriptDialogInputCheckBox("Send batch jobs through the provider batch API", settings.GetProviderBatchEnabled());
+inputs.Insert(providerBatchInput);
+
+ScriptDialogInputText spoolDirectoryInput = new ScriptDialogInputText("Bridge spool directory", settings.GetSpoolDirectory());
+inputs.Insert(spoolDirectoryInput);
 
 ScriptDialogInputCheckBox autoInsertInput = new ScriptDialogInputCheckBox("Insert generated code automatically", settings.GetAutoInsertCode());
 inputs.Insert(autoInsertInput);
@@ -158,12 +241,24 @@ inputs.Insert(autoInsertInput);
 ScriptDialogInputCheckBox confirmInput = new ScriptDialogInputCheckBox("Show confirmation dialogs", settings.GetShowConfirmationDialogs());
 inputs.Insert(confirmInput);
 
+ScriptDialogInputCheckBox streamInput = new ScriptDialogInputCheckBox("Stream partial responses", settings.GetStreamResponses());
+inputs.Insert(streamInput);
+
 ScriptDialogInputCheckBox saveHistoryInput = new ScriptDialogInputCheckBox("Persist request history", settings.GetSaveRequestHistory());
 inputs.Insert(saveHistoryInput);
 
 ScriptDialogInputText historyInput = new ScriptDialogInputText("Maximum history entries", settings.GetMaxHistoryEntries().ToString());
 inputs.Insert(historyInput);
 
+ScriptDialogInputText concurrencyInput = new ScriptDialogInputText("Concurrent requests", settings.GetMaxConcurrentRequests().ToString());
+inputs.Insert(concurrencyInput);
+
+ScriptDialogInputText timeoutInput = new ScriptDialogInputText("Response timeout (ms)", settings.GetResponseTimeoutMs().ToString());
+inputs.Insert(timeoutInput);
+
+ScriptDialogInputText pollIntervalInput = new ScriptDialogInputText("Max poll interval (ms)", settings.GetMaxPollIntervalMs().ToString());
+inputs.Insert(pollIntervalInput);
+
 bool confirmed = Workbench.ScriptDialog().Show("AI Copilot Settings", "Save", "Cancel", inputs);
 m_IsSettingsDialogOpen = false;
 
@@ -176,29 +271,35 @@ settings.SetModelName(modelInput.GetValue().Trim());
 settings.SetCustomEndpoint(endpointInput.GetValue().Trim());
 settings.SetTemperature(temperatureInput.GetValue().ToFloat());
 settings.SetMaxTokens(maxTokensInput.GetValue().ToInt());
+settings.SetPromptTokenBudget(promptBudgetInput.GetValue().ToInt());
+settings.SetLocalContextTokens(localContextInput.GetValue().ToInt());
+settings.SetLocalThreads(localThreadsInput.GetValue().ToInt());
+settings.SetCodeIndexEnabled(codeIndexInput.GetValue());
+settings.SetCodeIndexRoot(codeIndexRootInput.GetValue().Trim());
+settings.SetCodeIndexTopK(codeIndexTopKInput.GetValue().ToInt());
+settings.SetBatchParallelism(batchParallelismInput.GetValue().ToInt());
+settings.SetProviderBatchEnabled(providerBatchInput.GetValue());
 settings.SetAutoInsertCode(autoInsertInput.GetValue());
 settings.SetShowConfirmationDialogs(confirmInput.GetValue());
+settings.SetStreamResponses(streamInput.GetValue());
 settings.SetSaveRequestHistory(saveHistoryInput.GetValue());
 settings.SetMaxHistoryEntries(historyInput.GetValue().ToInt());
-settings.SetRequestFilePath(requestFileInput.GetValue().Trim());
-settings.SetResponseFilePath(responseFileInput.GetValue().Trim());
+settings.SetMaxConcurrentRequests(concurrencyInput.GetValue().ToInt());
+settings.SetResponseTimeoutMs(timeoutInput.GetValue().ToInt());
+settings.SetMaxPollIntervalMs(pollIntervalInput.GetValue().ToInt());
+settings.SetSpoolDirectory(spoolDirectoryInput.GetValue().Trim());
         }
 
         //-----------------------------------------------------------------------------
         //! Process AI request from UI
-        void ProcessAIRequest(AIRequestType requestType, string userInput)
+        //! The core snapshots the selection itself when includeSelection is set
+        void ProcessAIRequest(AIRequestType requestType, string userInput, bool bypassCache = false, bool includeSelection = true)
         {
-                if (m_AICore.IsProcessing())
-                {
-                        ShowMessage("AI Assistant is currently processing another request. Please wait...");
-                        return;
-                }
-
                 WorkbenchContext context = GetCurrentWorkbenchContext();
 
                 AIUIResponseCallback callback = new AIUIResponseCallback(this);
 
-                m_AICore.ProcessRequest(requestType, userInput, context, callback);
+                m_LastRequestId = m_AICore.ProcessRequest(requestType, userInput, context, callback, bypassCache, includeSelection);
 
                 UpdateUIForProcessing();
         }
@@ -217,7 +318,7 @@ settings.SetResponseFilePath(responseFileInput.GetValue().Trim());
         //! Notify user while processing a request
 protected void UpdateUIForProcessing()
 {
-Print("[AI Copilot] Processing request...");
+Print("[AI Copilot] Processing request... (" + m_AICore.GetActiveRequestCount() + " in flight, " + m_AICore.GetQueuedRequestCount() + " queued)");
 }
 
         //-----------------------------------------------------------------------------
@@ -228,11 +329,23 @@ Print("[AI Copilot] Processing request...");
                 UpdateUIForReady();
         }
 
+        //-----------------------------------------------------------------------------
+        //! Echo streamed text to the console while the full response is pending
+        void OnAIPartialReceived(string chunk)
+        {
+                PrintFormat("[AI Copilot] %1", chunk);
+        }
+
         //-----------------------------------------------------------------------------
         //! Handle AI error and update UI
         void OnAIErrorReceived(string error)
         {
-                ShowMessage("AI error: " + error);
+                // The user asked for it, no need to report it back
+                if (error == AIAssistantCore.REQUEST_CANCELLED)
+                        Print("[AI Copilot] " + error);
+                else
+                        ShowMessage("AI error: " + error);
+
                 UpdateUIForReady();
         }
 
@@ -247,6 +360,9 @@ Workbench.Dialog("AI Copilot Response", response, MessageBoxButtons.OK);
         //! Update UI when processing completes
 protected void UpdateUIForReady()
 {
+if (m_AICore.IsProcessing())
+return;
+
 Print("[AI Copilot] Ready");
 }
 
@@ -258,38 +374,151 @@ Print("[AI Copilot] Ready");
         }
 
         //-----------------------------------------------------------------------------
-        //! Show request history
+        //! Show request history as a paged browser
+        //! Only one page of summaries is rendered at a time; full responses are
+        //! loaded from the on-disk history when an entry is opened
         void ShowRequestHistory()
         {
-                array<ref AIRequest> history = m_AICore.GetRequestHistory();
+                array<ref AIHistoryEntry> history = m_AICore.GetRequestHistory();
+                if (history.IsEmpty())
+                {
+                        Workbench.Dialog("AI Copilot History", "No previous requests.", MessageBoxButtons.OK);
+                        return;
+                }
 
-                string historyText = "=== Request History ===\n\n";
+                AIHistoryIndex index = new AIHistoryIndex(history);
+                string query = "";
+                int typeChoice = 0;
+                array<int> matches = index.Search(query, -1);
+                int page = 0;
 
-                if (history.Count() == 0)
+                array<string> actionLabels = {"Next page", "Previous page", "Open entry", "Apply search"};
+                array<string> typeLabels = {"All types"};
+                typeLabels.InsertAll(m_RequestTypeLabels);
+
+                while (true)
                 {
-                        historyText += "No previous requests.";
+                        int pageCount = Math.Max(1, (matches.Count() + HISTORY_PAGE_SIZE - 1) / HISTORY_PAGE_SIZE);
+                        page = Math.ClampInt(page, 0, pageCount - 1);
+
+                        string title = string.Format("AI Copilot History (page %1/%2, %3 of %4 entries)", page + 1, pageCount, matches.Count(), history.Count());
+                        Workbench.Dialog(title, RenderHistoryPage(history, matches, page), MessageBoxButtons.OK);
+
+                        ref array<ref ScriptDialogInputBase> inputs = {};
+
+                        ScriptDialogInputCombo actionInput = new ScriptDialogInputCombo("Action", actionLabels, 0);
+                        inputs.Insert(actionInput);
+
+                        ScriptDialogInputText entryInput = new ScriptDialogInputText("Entry number", "");
+                        inputs.Insert(entryInput);
+
+                        ScriptDialogInputText searchInput = new ScriptDialogInputText("Search text", query);
+                        inputs.Insert(searchInput);
+
+                        ScriptDialogInputCombo typeInput = new ScriptDialogInputCombo("Request type", typeLabels, typeChoice);
+                        inputs.Insert(typeInput);
+
+                        if (!Workbench.ScriptDialog().Show("AI Copilot History", "Go", "Close", inputs))
+                                return;
+
+                        switch (actionInput.GetValue())
+                        {
+                                case 0:
+                                        page++;
+                                        break;
+
+                                case 1:
+                                        page--;
+                                        break;
+
+                                case 2:
+                                {
+                                        int position = entryInput.GetValue().Trim().ToInt() - 1;
+                                        if (position < 0 || position >= matches.Count())
+                                        {
+                                                ShowMessage("Enter an entry number from the list.");
+                                                break;
+                                        }
+
+                                        ShowHistoryEntry(history[matches[position]]);
+                                        break;
+                                }
+
+                                case 3:
+                                {
+                                        query = searchInput.GetValue().Trim();
+                                        typeChoice = typeInput.GetValue();
+
+                                        int typeFilter = -1;
+                                        if (typeChoice > 0)
+                                                typeFilter = m_RequestTypeValues[typeChoice - 1];
+
+                                        matches = index.Search(query, typeFilter);
+                                        page = 0;
+                                        break;
+                                }
+                        }
                 }
-                else
+        }
+
+        //-----------------------------------------------------------------------------
+        //! Render one page of one-line summaries, numbered across the filtered list
+        protected string RenderHistoryPage(array<ref AIHistoryEntry> history, array<int> matches, int page)
+        {
+                if (matches.IsEmpty())
+                        return "No requests match the current search.";
+
+                array<string> pieces = {};
+                int first = page * HISTORY_PAGE_SIZE;
+                int last = Math.Min(first + HISTORY_PAGE_SIZE, matches.Count());
+
+                for (int i = first; i < last; i++)
                 {
-                        for (int i = history.Count() - 1; i >= 0; i--)
-                        {
-                                AIRequest request = history[i];
-                                historyText += "Request: " + request.userInput + "\n";
-                                historyText += "Type: " + EnumToString(typeof(AIRequestType), request.type) + "\n";
-                                historyText += "Completed: " + (request.isCompleted ? "Yes" : "No") + "\n";
+                        AIHistoryEntry entry = history[matches[i]];
 
-                                if (!request.response.IsEmpty())
-                                        historyText += "Response: " + request.response + "\n";
+                        string status = "pending";
+                        if (!entry.errorMessage.IsEmpty())
+                                status = "error";
+                        else if (entry.isCompleted)
+                                status = "done";
 
-                                if (!request.errorMessage.IsEmpty())
-                                        historyText += "Error: " + request.errorMessage + "\n";
+                        string summary = AIRequestHistory.Truncate(entry.userInput, HISTORY_SUMMARY_LENGTH);
+                        summary.Replace("\n", " ");
 
-                                historyText += "---\n";
-                        }
+                        pieces.Insert(string.Format("%1. [%2, %3] %4\n", i + 1, EnumToString(typeof(AIRequestType), entry.type), status, summary));
                 }
 
-Workbench.Dialog("AI Copilot History", historyText, MessageBoxButtons.OK);
-}
+                return AIJSONUtils.JoinStrings(pieces);
+        }
+
+        //-----------------------------------------------------------------------------
+        //! Show one entry in full, loading its response on demand
+        protected void ShowHistoryEntry(AIHistoryEntry entry)
+        {
+                string details = "Request: " + entry.userInput + "\n";
+                details += "Type: " + EnumToString(typeof(AIRequestType), entry.type) + "\n";
+                details += "Completed: " + (entry.isCompleted ? "Yes" : "No") + "\n";
+
+                if (entry.pollCount > 0)
+                        details += "Polls: " + entry.pollCount + ", detected within " + entry.detectionLatencyMs + " ms, read " + entry.responseBytes + " bytes in " + entry.responseReadMs + " ms\n";
+
+                if (entry.estimatedInputTokens > 0)
+                {
+                        details += "Input tokens: ~" + entry.estimatedInputTokens + " estimated";
+                        if (entry.inputTokens >= 0)
+                                details += ", " + entry.inputTokens + " actual (" + entry.outputTokens + " output)";
+                        details += "\n";
+                }
+
+                if (!entry.errorMessage.IsEmpty())
+                        details += "Error: " + entry.errorMessage + "\n";
+
+                string response = m_AICore.GetHistoryResponse(entry);
+                if (!response.IsEmpty())
+                        details += "\nResponse:\n" + response;
+
+                Workbench.Dialog("AI Copilot History Entry", details, MessageBoxButtons.OK);
+        }
 }
 
 //-----------------------------------------------------------------------------
@@ -308,6 +537,11 @@ class AIUIResponseCallback : AIResponseCallback
                 m_UI.OnAIResponseReceived(response);
         }
 
+        override void OnPartial(string chunk)
+        {
+                m_UI.OnAIPartialReceived(chunk);
+        }
+
         override void OnError(string error)
         {
                 m_UI.OnAIErrorReceived(error);
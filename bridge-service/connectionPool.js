@@ -0,0 +1,219 @@
+const http = require('http');
+const https = require('https');
+const http2 = require('http2');
+const axios = require('axios');
+
+// Keep-alive connection pool for provider endpoints, one pool per origin.
+// HTTP/1.1 goes through pooled agents handed to axios; with http2 enabled, https
+// origins share a single multiplexed HTTP/2 session instead.
+class ProviderConnectionPool {
+  constructor({ keepAlive = true, maxSockets = 16, maxFreeSockets = 4, idleTimeoutMs = 30000, http2: useHttp2 = false, logger }) {
+    this.options = { keepAlive, maxSockets, maxFreeSockets, idleTimeoutMs, http2: useHttp2 };
+    this.logger = logger;
+    this.origins = new Map();
+  }
+
+  getOrigin(url) {
+    let origin = this.origins.get(url.origin);
+    if (origin) return origin;
+
+    const useHttp2 = this.options.http2 && url.protocol === 'https:';
+    origin = {
+      protocol: useHttp2 ? 'h2' : 'http/1.1',
+      agent: null,
+      session: null,
+      stats: { requests: 0, newConnections: 0, handshakes: 0, handshakeMsTotal: 0, handshakeMsMax: 0 }
+    };
+
+    if (!useHttp2) {
+      const Agent = url.protocol === 'https:' ? https.Agent : http.Agent;
+      origin.agent = new Agent({
+        keepAlive: this.options.keepAlive,
+        maxSockets: this.options.maxSockets,
+        maxFreeSockets: this.options.maxFreeSockets,
+        timeout: this.options.idleTimeoutMs,
+        scheduling: 'lifo'
+      });
+      this.instrumentAgent(origin, url.protocol === 'https:');
+    }
+
+    this.origins.set(url.origin, origin);
+    return origin;
+  }
+
+  // Count new sockets and time their connect/TLS handshake
+  instrumentAgent(origin, secure) {
+    const agent = origin.agent;
+    const createConnection = agent.createConnection.bind(agent);
+
+    agent.createConnection = (...args) => {
+      const startedAt = process.hrtime.bigint();
+      const socket = createConnection(...args);
+      origin.stats.newConnections++;
+      socket.once(secure ? 'secureConnect' : 'connect', () => {
+        this.recordHandshake(origin, startedAt);
+      });
+      return socket;
+    };
+  }
+
+  recordHandshake(origin, startedAt) {
+    const elapsedMs = Number(process.hrtime.bigint() - startedAt) / 1e6;
+    origin.stats.handshakes++;
+    origin.stats.handshakeMsTotal += elapsedMs;
+    origin.stats.handshakeMsMax = Math.max(origin.stats.handshakeMsMax, elapsedMs);
+  }
+
+  // POST a JSON payload; resolves with { status, data } like axios.
+  // Aborting signal cancels the request and frees its socket or stream.
+  async post(endpoint, payload, { headers = {}, timeout = 60000, responseType = 'json', signal } = {}) {
+    if (signal && signal.aborted) throw signal.reason;
+
+    const url = new URL(endpoint);
+    const origin = this.getOrigin(url);
+    origin.stats.requests++;
+
+    if (origin.protocol === 'h2') {
+      return this.postHttp2(url, origin, payload, { headers, timeout, responseType, signal });
+    }
+
+    return axios.post(endpoint, payload, {
+      headers,
+      timeout,
+      responseType,
+      signal,
+      httpAgent: url.protocol === 'http:' ? origin.agent : undefined,
+      httpsAgent: url.protocol === 'https:' ? origin.agent : undefined
+    });
+  }
+
+  getHttp2Session(url, origin) {
+    if (origin.session && !origin.session.closed && !origin.session.destroyed) {
+      return origin.session;
+    }
+
+    const startedAt = process.hrtime.bigint();
+    const session = http2.connect(url.origin);
+    origin.stats.newConnections++;
+    origin.session = session;
+
+    session.once('connect', () => this.recordHandshake(origin, startedAt));
+    session.setTimeout(this.options.idleTimeoutMs, () => session.close());
+    session.on('error', (error) => this.logger.warn(`HTTP/2 session error for ${url.origin}: ${error.message}`));
+
+    const forget = () => {
+      if (origin.session === session) origin.session = null;
+    };
+    session.once('close', forget);
+    session.once('goaway', forget);
+
+    return session;
+  }
+
+  postHttp2(url, origin, payload, { headers, timeout, responseType, signal }) {
+    const session = this.getHttp2Session(url, origin);
+    const body = JSON.stringify(payload);
+
+    const requestHeaders = {
+      ':method': 'POST',
+      ':path': url.pathname + url.search,
+      'content-length': Buffer.byteLength(body)
+    };
+    for (const [name, value] of Object.entries(headers)) {
+      requestHeaders[name.toLowerCase()] = value;
+    }
+
+    return new Promise((resolve, reject) => {
+      const request = session.request(requestHeaders);
+
+      // One deadline for the whole exchange, a streamed body included. The stream's own
+      // setTimeout is an idle timer, and closing the stream from it after the response
+      // was handed out left the reader waiting for an end that never came; destroying
+      // it with the error reaches the reader as a stream error instead.
+      const deadline = setTimeout(() => {
+        request.close(http2.constants.NGHTTP2_CANCEL);
+        request.destroy(new Error(`timeout of ${timeout}ms exceeded`));
+      }, timeout);
+      request.once('close', () => clearTimeout(deadline));
+      request.on('error', reject);
+
+      if (signal) {
+        const onAbort = () => {
+          request.close(http2.constants.NGHTTP2_CANCEL);
+          reject(signal.reason);
+        };
+        signal.addEventListener('abort', onAbort, { once: true });
+        request.once('close', () => signal.removeEventListener('abort', onAbort));
+      }
+
+      request.on('response', (responseHeaders) => {
+        const status = responseHeaders[':status'];
+        const ok = status >= 200 && status < 300;
+
+        if (ok && responseType === 'stream') {
+          resolve({ status, headers: responseHeaders, data: request });
+          return;
+        }
+
+        const chunks = [];
+        request.on('data', (chunk) => chunks.push(chunk));
+        request.on('end', () => {
+          const text = Buffer.concat(chunks).toString('utf8');
+          let data = text;
+          try {
+            data = JSON.parse(text);
+          } catch (error) {
+            // Leave non-JSON bodies as text
+          }
+
+          if (ok) {
+            resolve({ status, headers: responseHeaders, data });
+          } else {
+            const error = new Error(`Request failed with status code ${status}`);
+            error.response = { status, data };
+            reject(error);
+          }
+        });
+      });
+
+      request.end(body);
+    });
+  }
+
+  getStats() {
+    const stats = {};
+    for (const [originName, origin] of this.origins) {
+      let openSockets = 0;
+      let freeSockets = 0;
+      if (origin.agent) {
+        for (const sockets of Object.values(origin.agent.sockets)) openSockets += sockets.length;
+        for (const sockets of Object.values(origin.agent.freeSockets)) freeSockets += sockets.length;
+      } else if (origin.session && !origin.session.closed) {
+        openSockets = 1;
+      }
+
+      const { requests, newConnections, handshakes, handshakeMsTotal, handshakeMsMax } = origin.stats;
+      stats[originName] = {
+        protocol: origin.protocol,
+        requests,
+        newConnections,
+        openSockets,
+        freeSockets,
+        reuseRatio: requests > 0 ? Math.max(0, requests - newConnections) / requests : 0,
+        avgHandshakeMs: handshakes > 0 ? handshakeMsTotal / handshakes : 0,
+        maxHandshakeMs: handshakeMsMax
+      };
+    }
+    return stats;
+  }
+
+  close() {
+    for (const origin of this.origins.values()) {
+      if (origin.agent) origin.agent.destroy();
+      if (origin.session) origin.session.close();
+    }
+    this.origins.clear();
+  }
+}
+
+module.exports = { ProviderConnectionPool };
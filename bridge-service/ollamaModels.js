@@ -0,0 +1,156 @@
+const axios = require('axios');
+
+// Keeps local Ollama models loaded so prompts do not pay a multi-second model load.
+// Every generate request carries keep_alive, and the configured warm models are
+// loaded at startup and pinged every pingIntervalMs while no request used them;
+// a ping loads a model again if something else on the box evicted it.
+// num_ctx and num_thread go into the request options. Ollama reloads a model whose
+// options change, so pings reuse the options of the model's last request.
+// Load and inference times come from the load_duration, prompt_eval_duration and
+// eval_duration Ollama reports (see normalizeUsage in streaming.js).
+const COLD_LOAD_MS = 500;
+
+class OllamaModelManager {
+  constructor({ endpoint, models = [], keepAlive = '30m', pingIntervalMs = 240000, numCtx = 0, numThread = 0, timeoutMs = 300000, logger }) {
+    this.endpoint = endpoint;
+    this.warmModels = models;
+    this.keepAlive = keepAlive;
+    this.pingIntervalMs = pingIntervalMs;
+    this.numCtx = numCtx;
+    this.numThread = numThread;
+    this.timeoutMs = timeoutMs;
+    this.logger = logger;
+    this.models = new Map();
+    this.timer = null;
+    this.pinging = false;
+  }
+
+  modelState(model) {
+    let state = this.models.get(model);
+    if (!state) {
+      state = {
+        options: this.optionsFor({}),
+        lastUsedAt: 0,
+        requests: 0,
+        coldStarts: 0,
+        loadMs: 0,
+        inferenceMs: 0,
+        pings: 0,
+        pingFailures: 0,
+        loaded: false
+      };
+      this.models.set(model, state);
+    }
+    return state;
+  }
+
+  // Request settings numCtx/numThread override the bridge defaults; 0 leaves the model's own
+  optionsFor(settings = {}) {
+    const options = {};
+    const numCtx = parseInt(settings.numCtx, 10) || this.numCtx;
+    const numThread = parseInt(settings.numThread, 10) || this.numThread;
+    if (numCtx > 0) options.num_ctx = numCtx;
+    if (numThread > 0) options.num_thread = numThread;
+    return Object.keys(options).length > 0 ? options : undefined;
+  }
+
+  // keep_alive and options for a generate payload
+  apply(payload, settings) {
+    payload.keep_alive = this.keepAlive;
+    const options = this.optionsFor(settings);
+    if (options) payload.options = options;
+    return payload;
+  }
+
+  noteRequest(model, options) {
+    const state = this.modelState(model);
+    state.options = options;
+    state.lastUsedAt = Date.now();
+  }
+
+  // Log and count a finished request's load and inference time
+  record(model, usage) {
+    if (!usage || usage.loadMs === undefined) return;
+
+    const state = this.modelState(model);
+    const inferenceMs = (usage.promptEvalMs || 0) + (usage.evalMs || 0);
+    state.requests++;
+    state.loadMs += usage.loadMs;
+    state.inferenceMs += inferenceMs;
+    state.loaded = true;
+    if (usage.loadMs >= COLD_LOAD_MS) state.coldStarts++;
+
+    this.logger.info(`Ollama ${model}: ${usage.loadMs} ms loading, ${inferenceMs} ms inference (${usage.promptEvalMs ?? '?'} ms prompt, ${usage.evalMs ?? '?'} ms generation)`);
+  }
+
+  start() {
+    if (this.warmModels.length === 0) return;
+
+    this.pingAll(true);
+    this.timer = setInterval(() => this.pingAll(false), this.pingIntervalMs);
+    this.timer.unref();
+  }
+
+  // One model at a time, so a shared box is not asked to load several at once
+  async pingAll(initial) {
+    if (this.pinging) return;
+    this.pinging = true;
+
+    try {
+      for (const model of this.warmModels) {
+        const state = this.modelState(model);
+        if (!initial && Date.now() - state.lastUsedAt < this.pingIntervalMs) continue;
+        await this.ping(model, state, initial);
+      }
+    } finally {
+      this.pinging = false;
+    }
+  }
+
+  // A generate request without a prompt loads the model and resets its keep_alive
+  async ping(model, state, initial) {
+    const payload = { model, keep_alive: this.keepAlive, stream: false };
+    if (state.options) payload.options = state.options;
+
+    try {
+      const response = await axios.post(this.endpoint, payload, { timeout: this.timeoutMs });
+      const loadMs = Math.round((response.data.load_duration || 0) / 1e6);
+      state.pings++;
+      state.lastUsedAt = Date.now();
+
+      if (initial) {
+        this.logger.info(`Pre-loaded Ollama model ${model} in ${loadMs} ms`);
+      } else if (loadMs >= COLD_LOAD_MS || !state.loaded) {
+        this.logger.info(`Reloaded Ollama model ${model} in ${loadMs} ms`);
+      }
+      state.loaded = true;
+    } catch (error) {
+      state.pingFailures++;
+      state.loaded = false;
+      this.logger.warn(`Keep-alive ping for Ollama model ${model} failed: ${error.response?.data?.error || error.message}`);
+    }
+  }
+
+  getStats() {
+    const models = {};
+    for (const [model, state] of this.models) {
+      models[model] = {
+        warm: this.warmModels.includes(model),
+        loaded: state.loaded,
+        requests: state.requests,
+        coldStarts: state.coldStarts,
+        avgLoadMs: state.requests ? Math.round(state.loadMs / state.requests) : null,
+        avgInferenceMs: state.requests ? Math.round(state.inferenceMs / state.requests) : null,
+        pings: state.pings,
+        pingFailures: state.pingFailures
+      };
+    }
+    return { keepAlive: this.keepAlive, pingIntervalMs: this.pingIntervalMs, models };
+  }
+
+  close() {
+    clearInterval(this.timer);
+  }
+}
+
+module.exports = { OllamaModelManager };
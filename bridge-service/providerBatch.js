@@ -0,0 +1,302 @@
+const axios = require('axios');
+const { normalizeUsage } = require('./streaming');
+
+// Bulk backend on the providers' batch APIs, for requests nobody is waiting on.
+// Requests are collected per service, API key and model, and a group is submitted
+// once it holds maxRequests or maxWaitMs after its first request:
+//   claude  one Message Batches call; results are read back as JSONL
+//   openai  a JSONL input file plus a batch over /v1/chat/completions
+// Submitted batches are polled until they end, and each result line is matched
+// back to its request by custom_id. Batches trade latency (minutes to hours) for
+// throughput and a lower price.
+const OPENAI_ENDED = new Set(['completed', 'failed', 'expired', 'cancelled']);
+
+class ProviderBatchQueue {
+  constructor({ urls, maxRequests = 1000, maxWaitMs = 60000, pollIntervalMs = 30000, timeoutMs = 60000, logger }) {
+    this.urls = urls;
+    this.maxRequests = maxRequests;
+    this.maxWaitMs = maxWaitMs;
+    this.pollIntervalMs = pollIntervalMs;
+    this.timeoutMs = timeoutMs;
+    this.logger = logger;
+    this.groups = new Map();
+    this.batches = new Map();
+    this.nextId = 0;
+    this.stats = { queued: 0, submitted: 0, batches: 0, succeeded: 0, failed: 0, cancelled: 0 };
+  }
+
+  supports(service) {
+    return !!this.urls[service];
+  }
+
+  // Resolves with { text, usage } once the request's batch has ended.
+  // headers carry the provider's authentication; payload is the synchronous request body.
+  // Aborting signal drops the request; a batch whose requests were all dropped is cancelled.
+  submit({ service, apiKey, headers, payload }, { signal } = {}) {
+    if (signal && signal.aborted) return Promise.reject(signal.reason);
+
+    return new Promise((resolve, reject) => {
+      const { stream, stream_options: streamOptions, ...body } = payload;
+      const item = {
+        customId: `req-${Date.now().toString(36)}-${this.nextId++}`,
+        body,
+        resolve,
+        reject,
+        settled: false,
+        batchId: null
+      };
+
+      const groupKey = `${service}\n${apiKey || ''}\n${body.model}`;
+      let group = this.groups.get(groupKey);
+      if (!group) {
+        group = { service, headers, items: [], timer: setTimeout(() => this.flush(groupKey), this.maxWaitMs) };
+        this.groups.set(groupKey, group);
+      }
+
+      group.items.push(item);
+      this.stats.queued++;
+
+      if (signal) {
+        signal.addEventListener('abort', () => this.abandon(groupKey, item, signal.reason), { once: true });
+      }
+
+      if (group.items.length >= this.maxRequests) this.flush(groupKey);
+    });
+  }
+
+  settle(item, error, result) {
+    if (item.settled) return;
+    item.settled = true;
+    if (error) item.reject(error);
+    else item.resolve(result);
+  }
+
+  abandon(groupKey, item, reason) {
+    if (item.settled) return;
+
+    this.stats.cancelled++;
+    this.settle(item, reason);
+
+    const group = this.groups.get(groupKey);
+    if (group && !item.batchId) {
+      group.items = group.items.filter((queued) => queued !== item);
+      if (group.items.length === 0) {
+        clearTimeout(group.timer);
+        this.groups.delete(groupKey);
+      }
+      return;
+    }
+
+    const batch = this.batches.get(item.batchId);
+    if (batch && [...batch.items.values()].every((member) => member.settled)) {
+      this.cancelBatch(item.batchId, batch);
+    }
+  }
+
+  flush(groupKey) {
+    const group = this.groups.get(groupKey);
+    if (!group) return;
+
+    clearTimeout(group.timer);
+    this.groups.delete(groupKey);
+
+    const items = group.items.filter((item) => !item.settled);
+    if (items.length === 0) return;
+
+    this.submitBatch(group.service, group.headers, items).catch((error) => {
+      const message = error.response?.data?.error?.message || error.message;
+      this.logger.error(`Provider batch submission for ${group.service} failed: ${message}`);
+      this.stats.failed += items.length;
+      items.forEach((item) => this.settle(item, new Error(`Provider batch submission failed: ${message}`)));
+    });
+  }
+
+  async submitBatch(service, headers, items) {
+    const batchId = service === 'claude'
+      ? await this.submitClaude(headers, items)
+      : await this.submitOpenAI(headers, items);
+
+    const batch = { service, headers, items: new Map(), timer: null, submittedAt: Date.now() };
+    for (const item of items) {
+      item.batchId = batchId;
+      batch.items.set(item.customId, item);
+    }
+
+    this.batches.set(batchId, batch);
+    this.stats.batches++;
+    this.stats.submitted += items.length;
+    this.logger.info(`Submitted ${service} batch ${batchId} with ${items.length} requests`);
+
+    // A request dropped while the submission was in flight may leave nobody waiting
+    if (items.every((item) => item.settled)) {
+      this.cancelBatch(batchId, batch);
+      return;
+    }
+
+    this.schedulePoll(batchId, batch);
+  }
+
+  async submitClaude(headers, items) {
+    const response = await axios.post(this.urls.claude, {
+      requests: items.map((item) => ({ custom_id: item.customId, params: item.body }))
+    }, { headers, timeout: this.timeoutMs });
+    return response.data.id;
+  }
+
+  async submitOpenAI(headers, items) {
+    const jsonl = items
+      .map((item) => JSON.stringify({ custom_id: item.customId, method: 'POST', url: '/v1/chat/completions', body: item.body }))
+      .join('\n') + '\n';
+
+    // The upload is multipart; only the authentication headers carry over
+    const { 'Content-Type': contentType, ...authHeaders } = headers;
+    const form = new FormData();
+    form.append('purpose', 'batch');
+    form.append('file', new Blob([jsonl], { type: 'application/jsonl' }), 'batch.jsonl');
+
+    const upload = await axios.post(`${this.urls.openai}/files`, form, { headers: authHeaders, timeout: this.timeoutMs });
+    const response = await axios.post(`${this.urls.openai}/batches`, {
+      input_file_id: upload.data.id,
+      endpoint: '/v1/chat/completions',
+      completion_window: '24h'
+    }, { headers, timeout: this.timeoutMs });
+    return response.data.id;
+  }
+
+  schedulePoll(batchId, batch) {
+    batch.timer = setTimeout(() => {
+      this.poll(batchId, batch)
+        .then((ended) => {
+          if (!ended && this.batches.get(batchId) === batch) this.schedulePoll(batchId, batch);
+        })
+        .catch((error) => {
+          // Transient failures only delay the next poll
+          this.logger.warn(`Polling ${batch.service} batch ${batchId} failed: ${error.message}`);
+          if (this.batches.get(batchId) === batch) this.schedulePoll(batchId, batch);
+        });
+    }, this.pollIntervalMs);
+  }
+
+  // True once the batch has ended and its results were delivered
+  async poll(batchId, batch) {
+    let lines;
+    let endStatus;
+
+    if (batch.service === 'claude') {
+      const status = await axios.get(`${this.urls.claude}/${batchId}`, { headers: batch.headers, timeout: this.timeoutMs });
+      if (status.data.processing_status !== 'ended') return false;
+
+      endStatus = 'ended';
+      lines = await this.fetchLines(status.data.results_url, batch.headers);
+    } else {
+      const status = await axios.get(`${this.urls.openai}/batches/${batchId}`, { headers: batch.headers, timeout: this.timeoutMs });
+      if (!OPENAI_ENDED.has(status.data.status)) return false;
+
+      endStatus = status.data.status;
+      lines = [];
+      for (const fileId of [status.data.output_file_id, status.data.error_file_id]) {
+        if (fileId) lines.push(...await this.fetchLines(`${this.urls.openai}/files/${fileId}/content`, batch.headers));
+      }
+    }
+
+    for (const line of lines) {
+      const item = batch.items.get(line.custom_id);
+      if (!item) continue;
+
+      const outcome = batch.service === 'claude' ? this.readClaudeResult(line) : this.readOpenAIResult(line);
+      if (outcome.error) this.stats.failed++;
+      else this.stats.succeeded++;
+      this.settle(item, outcome.error, outcome.result);
+    }
+
+    // Requests missing from the results, e.g. when the whole batch failed or expired
+    for (const item of batch.items.values()) {
+      if (!item.settled) {
+        this.stats.failed++;
+        this.settle(item, new Error(`Provider batch ${batchId} ${endStatus} without a result for this request`));
+      }
+    }
+
+    this.batches.delete(batchId);
+    this.logger.info(`${batch.service} batch ${batchId} ${endStatus} after ${Math.round((Date.now() - batch.submittedAt) / 1000)} s`);
+    return true;
+  }
+
+  async fetchLines(url, headers) {
+    const response = await axios.get(url, { headers, timeout: this.timeoutMs, responseType: 'text' });
+    return String(response.data)
+      .split('\n')
+      .filter((line) => line.trim())
+      .map((line) => {
+        try {
+          return JSON.parse(line);
+        } catch (error) {
+          this.logger.warn(`Skipping malformed batch result line: ${error.message}`);
+          return {};
+        }
+      });
+  }
+
+  readClaudeResult(line) {
+    const result = line.result || {};
+    if (result.type !== 'succeeded') {
+      const message = result.error?.error?.message || result.error?.message || `request ${result.type || 'failed'}`;
+      return { error: new Error(`Provider batch: ${message}`) };
+    }
+
+    const text = (result.message.content || [])
+      .filter((block) => block.type === 'text')
+      .map((block) => block.text)
+      .join('');
+    return { result: { text, usage: normalizeUsage('claude', result.message) } };
+  }
+
+  readOpenAIResult(line) {
+    const response = line.response;
+    if (!response || response.status_code !== 200) {
+      const message = line.error?.message || response?.body?.error?.message || `status ${response?.status_code}`;
+      return { error: new Error(`Provider batch: ${message}`) };
+    }
+
+    return { result: { text: response.body.choices[0].message.content, usage: normalizeUsage('openai', response.body) } };
+  }
+
+  // Nobody waits for the batch any more; stop the provider from processing the rest
+  cancelBatch(batchId, batch) {
+    clearTimeout(batch.timer);
+    this.batches.delete(batchId);
+
+    const url = batch.service === 'claude'
+      ? `${this.urls.claude}/${batchId}/cancel`
+      : `${this.urls.openai}/batches/${batchId}/cancel`;
+
+    axios.post(url, {}, { headers: batch.headers, timeout: this.timeoutMs })
+      .then(() => this.logger.info(`Cancelled ${batch.service} batch ${batchId}`))
+      .catch((error) => this.logger.warn(`Cancelling ${batch.service} batch ${batchId} failed: ${error.message}`));
+  }
+
+  getStats() {
+    let collecting = 0;
+    for (const group of this.groups.values()) collecting += group.items.length;
+
+    let waiting = 0;
+    for (const batch of this.batches.values()) {
+      for (const item of batch.items.values()) if (!item.settled) waiting++;
+    }
+
+    return {
+      enabled: true,
+      collecting,
+      activeBatches: this.batches.size,
+      waiting,
+      ...this.stats
+    };
+  }
+
+  close() {
+    for (const group of this.groups.values()) clearTimeout(group.timer);
+    for (const batch of this.batches.values()) clearTimeout(batch.timer);
+  }
+}
+
+module.exports = { ProviderBatchQueue };
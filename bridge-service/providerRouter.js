@@ -0,0 +1,300 @@
+// Latency-aware routing across provider targets (a service plus a model).
+// Each target keeps a rolling window of latencies and outcomes, from which p50/p95
+// and the error rate are derived, and a circuit breaker:
+//   closed     calls go through
+//   open       the target is skipped until cooldownMs has passed
+//   half-open  one probe call decides between closed and open
+// A request goes to the fastest healthy target. When hedging is on and it has not
+// answered after the target's hedge-percentile latency, the next target is tried as
+// well and the first answer wins; the loser is aborted. A failed attempt fails over
+// to the next target right away.
+const BREAKER_CLOSED = 'closed';
+const BREAKER_OPEN = 'open';
+const BREAKER_HALF_OPEN = 'half-open';
+
+function percentile(sortedValues, p) {
+  if (sortedValues.length === 0) return undefined;
+  const index = Math.min(sortedValues.length - 1, Math.ceil((p / 100) * sortedValues.length) - 1);
+  return sortedValues[Math.max(0, index)];
+}
+
+function lostRaceError() {
+  const error = new Error('Another provider answered first');
+  error.name = 'AbortError';
+  return error;
+}
+
+class ProviderRouter {
+  constructor({
+    windowSize = 100,
+    minSamples = 5,
+    hedging = true,
+    hedgePercentile = 95,
+    hedgeDelayMs = 10000,
+    hedgeMinDelayMs = 500,
+    failureThreshold = 3,
+    errorRateThreshold = 0.5,
+    cooldownMs = 30000,
+    logger
+  } = {}) {
+    this.windowSize = windowSize;
+    this.minSamples = minSamples;
+    this.hedging = hedging;
+    this.hedgePercentile = hedgePercentile;
+    this.hedgeDelayMs = hedgeDelayMs;
+    this.hedgeMinDelayMs = hedgeMinDelayMs;
+    this.failureThreshold = failureThreshold;
+    this.errorRateThreshold = errorRateThreshold;
+    this.cooldownMs = cooldownMs;
+    this.logger = logger;
+    this.targets = new Map();
+    this.stats = { routed: 0, rerouted: 0, hedged: 0, hedgeWins: 0, failovers: 0, rejected: 0 };
+  }
+
+  stateFor(key) {
+    let state = this.targets.get(key);
+    if (!state) {
+      state = {
+        latencies: [],
+        outcomes: [],
+        consecutiveFailures: 0,
+        breaker: BREAKER_CLOSED,
+        openedAt: 0,
+        probing: false,
+        calls: 0,
+        failures: 0
+      };
+      this.targets.set(key, state);
+    }
+    return state;
+  }
+
+  // Successful latencies only; a fast failure says nothing about speed
+  record(key, latencyMs, ok) {
+    const state = this.stateFor(key);
+    state.calls++;
+    state.outcomes.push(ok);
+    if (state.outcomes.length > this.windowSize) state.outcomes.shift();
+
+    if (ok) {
+      state.latencies.push(latencyMs);
+      if (state.latencies.length > this.windowSize) state.latencies.shift();
+      state.consecutiveFailures = 0;
+      if (state.breaker !== BREAKER_CLOSED) {
+        this.logger.info(`Circuit for ${key} closed`);
+      }
+      state.breaker = BREAKER_CLOSED;
+      state.probing = false;
+      return;
+    }
+
+    state.failures++;
+    state.consecutiveFailures++;
+    state.probing = false;
+
+    const errorRate = this.errorRate(state);
+    const tripped = state.breaker === BREAKER_HALF_OPEN ||
+      state.consecutiveFailures >= this.failureThreshold ||
+      (state.outcomes.length >= this.minSamples && errorRate > this.errorRateThreshold);
+
+    if (tripped) {
+      if (state.breaker !== BREAKER_OPEN) {
+        this.logger.warn(`Circuit for ${key} opened (${state.consecutiveFailures} consecutive failures, ${Math.round(errorRate * 100)}% errors)`);
+      }
+      state.breaker = BREAKER_OPEN;
+      state.openedAt = Date.now();
+    }
+  }
+
+  // An attempt aborted because another target answered first took at least this
+  // long; without it a target that always loses the race would never get measured
+  recordLowerBound(key, latencyMs) {
+    const state = this.stateFor(key);
+    state.latencies.push(latencyMs);
+    if (state.latencies.length > this.windowSize) state.latencies.shift();
+  }
+
+  errorRate(state) {
+    if (state.outcomes.length === 0) return 0;
+    return state.outcomes.filter((ok) => !ok).length / state.outcomes.length;
+  }
+
+  latencyPercentile(key, p) {
+    const state = this.targets.get(key);
+    if (!state || state.latencies.length < this.minSamples) return undefined;
+    return percentile([...state.latencies].sort((a, b) => a - b), p);
+  }
+
+  // Whether a call may go to the target now; an expired open circuit admits one probe
+  available(key) {
+    const state = this.stateFor(key);
+    if (state.breaker === BREAKER_CLOSED) return true;
+
+    if (state.breaker === BREAKER_OPEN && Date.now() - state.openedAt >= this.cooldownMs) {
+      state.breaker = BREAKER_HALF_OPEN;
+      state.probing = false;
+    }
+
+    return state.breaker === BREAKER_HALF_OPEN && !state.probing;
+  }
+
+  // Available targets, fastest p50 first. The requested target (the first candidate)
+  // keeps first place until its measurements show an alternate is faster.
+  order(candidates) {
+    const rank = (target, index) => {
+      const p50 = this.latencyPercentile(target.key, 50);
+      if (p50 !== undefined) return p50;
+      return index === 0 ? -1 : Infinity;
+    };
+
+    return candidates
+      .map((target, index) => ({ target, rank: rank(target, index), index }))
+      .filter((entry) => this.available(entry.target.key))
+      .sort((a, b) => (a.rank - b.rank) || (a.index - b.index))
+      .map((entry) => entry.target);
+  }
+
+  hedgeDelayFor(key) {
+    const latency = this.latencyPercentile(key, this.hedgePercentile);
+    if (latency === undefined) return this.hedgeDelayMs;
+    return Math.max(this.hedgeMinDelayMs, latency);
+  }
+
+  // attempt(target, hooks) performs one call and resolves with its result.
+  // hooks.onChunk receives the stream of the first target to produce text; the
+  // others are aborted then, since a stream cannot switch providers halfway.
+  // Resolves with the winning result; aborting hooks.signal aborts every attempt.
+  run(candidates, attempt, hooks = {}) {
+    if (hooks.signal && hooks.signal.aborted) return Promise.reject(hooks.signal.reason);
+
+    const ordered = this.order(candidates);
+    if (ordered.length === 0) {
+      this.stats.rejected++;
+      return Promise.reject(new Error(`No provider available, circuits open for: ${candidates.map((target) => target.key).join(', ')}`));
+    }
+
+    this.stats.routed++;
+    if (ordered[0] !== candidates[0]) {
+      this.stats.rerouted++;
+      this.logger.info(`Routing ${candidates[0].key} request to ${ordered[0].key}`);
+    }
+
+    return new Promise((resolve, reject) => {
+      const attempts = [];
+      const errors = [];
+      let next = 0;
+      let settled = false;
+      let streamOwner = null;
+      let hedgeTimer = null;
+
+      const abortOthers = (keep, reason) => {
+        attempts.forEach((other) => {
+          if (other === keep || other.done) return;
+          if (keep) this.recordLowerBound(other.target.key, Date.now() - other.startedAt);
+          other.controller.abort(reason);
+        });
+      };
+
+      const onCallerAbort = () => finish(hooks.signal.reason);
+
+      const finish = (error, result, winner = null) => {
+        if (settled) return;
+        settled = true;
+        clearTimeout(hedgeTimer);
+        if (hooks.signal) hooks.signal.removeEventListener('abort', onCallerAbort);
+        abortOthers(winner, error || lostRaceError());
+        if (error) reject(error);
+        else resolve(result);
+      };
+
+      const launch = () => {
+        while (!settled && next < ordered.length) {
+          const target = ordered[next++];
+          // The circuit may have opened since the targets were ordered
+          if (attempts.length > 0 && !this.available(target.key)) continue;
+
+          const state = this.stateFor(target.key);
+          const probe = state.breaker === BREAKER_HALF_OPEN;
+          if (probe) state.probing = true;
+
+          const entry = { target, probe, controller: new AbortController(), done: false, startedAt: Date.now() };
+          attempts.push(entry);
+
+          const attemptHooks = { signal: entry.controller.signal };
+          if (hooks.onChunk) {
+            attemptHooks.onChunk = (text) => {
+              if (!streamOwner) {
+                streamOwner = entry;
+                clearTimeout(hedgeTimer);
+                abortOthers(entry, lostRaceError());
+              }
+              if (streamOwner === entry) hooks.onChunk(text);
+            };
+          }
+
+          attempt(target, attemptHooks).then((result) => {
+            entry.done = true;
+            this.record(target.key, Date.now() - entry.startedAt, true);
+            if (attempts.length > 1 && entry !== attempts[0]) this.stats.hedgeWins++;
+            finish(null, result, entry);
+          }, (error) => {
+            entry.done = true;
+            // Lost the race or cancelled by the caller; not the provider's fault. An
+            // aborted probe decided nothing, so the circuit stays half-open for the next one.
+            if (entry.controller.signal.aborted) {
+              if (entry.probe) state.probing = false;
+              return;
+            }
+
+            this.record(target.key, Date.now() - entry.startedAt, false);
+            errors.push(`${target.key}: ${error.message}`);
+
+            // Text already went to the caller; another provider cannot continue it
+            if (streamOwner === entry) {
+              finish(error);
+              return;
+            }
+
+            this.stats.failovers++;
+            if (!launch() && attempts.every((other) => other.done)) {
+              finish(new Error(`All providers failed: ${errors.join('; ')}`));
+            }
+          });
+          return true;
+        }
+        return false;
+      };
+
+      if (hooks.signal) hooks.signal.addEventListener('abort', onCallerAbort, { once: true });
+
+      launch();
+
+      if (this.hedging && ordered.length > 1) {
+        hedgeTimer = setTimeout(() => {
+          if (settled || streamOwner) return;
+          if (launch()) {
+            this.stats.hedged++;
+            this.logger.info(`Hedging ${ordered[0].key} request with ${attempts[attempts.length - 1].target.key}`);
+          }
+        }, this.hedgeDelayFor(ordered[0].key));
+      }
+    });
+  }
+
+  getStats() {
+    const targets = {};
+    for (const [key, state] of this.targets) {
+      targets[key] = {
+        breaker: state.breaker,
+        calls: state.calls,
+        failures: state.failures,
+        errorRate: this.errorRate(state),
+        p50Ms: this.latencyPercentile(key, 50) ?? null,
+        p95Ms: this.latencyPercentile(key, 95) ?? null
+      };
+    }
+    return { enabled: true, ...this.stats, targets };
+  }
+}
+
+module.exports = { ProviderRouter };
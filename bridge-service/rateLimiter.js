@@ -0,0 +1,221 @@
+const crypto = require('crypto');
+
+class RateLimitError extends Error {
+  constructor(message) {
+    super(message);
+    this.name = 'RateLimitError';
+    this.statusCode = 429;
+  }
+}
+
+// Token bucket refilled continuously; all operations are O(1)
+class TokenBucket {
+  constructor(requests, windowMs) {
+    this.capacity = Math.max(1, requests);
+    this.refillPerMs = this.capacity / windowMs;
+    this.tokens = this.capacity;
+    this.updatedAt = Date.now();
+  }
+
+  refill(now) {
+    if (now > this.updatedAt) {
+      this.tokens = Math.min(this.capacity, this.tokens + (now - this.updatedAt) * this.refillPerMs);
+      this.updatedAt = now;
+    }
+  }
+
+  available(now) {
+    this.refill(now);
+    return this.tokens >= 1;
+  }
+
+  take() {
+    this.tokens -= 1;
+  }
+
+  msUntilAvailable(now) {
+    this.refill(now);
+    return this.tokens >= 1 ? 0 : Math.ceil((1 - this.tokens) / this.refillPerMs);
+  }
+}
+
+// Per-service and per-API-key token buckets with a bounded priority wait queue.
+// Requests that find no token wait (higher priority first, FIFO within a priority)
+// instead of being rejected, up to maxQueueDepth waiters and maxWaitMs each.
+class RateLimiter {
+  constructor({ limits, keyLimits = {}, maxQueueDepth = 100, maxWaitMs = 30000, logger }) {
+    this.limits = limits;
+    this.keyLimits = keyLimits;
+    this.maxQueueDepth = maxQueueDepth;
+    this.maxWaitMs = maxWaitMs;
+    this.logger = logger;
+
+    this.serviceBuckets = new Map();
+    this.keyBuckets = new Map();
+    this.queues = new Map();
+    this.timers = new Map();
+    this.stats = {};
+  }
+
+  serviceStats(service) {
+    if (!this.stats[service]) {
+      this.stats[service] = { granted: 0, queued: 0, waited: 0, rejected: 0, cancelled: 0, maxQueueDepth: 0, waitMsTotal: 0, waitMsMax: 0 };
+    }
+    return this.stats[service];
+  }
+
+  bucketsFor(service, apiKey) {
+    const limit = this.limits[service];
+    if (!limit) return null;
+
+    let serviceBucket = this.serviceBuckets.get(service);
+    if (!serviceBucket) {
+      serviceBucket = new TokenBucket(limit.requests, limit.window);
+      this.serviceBuckets.set(service, serviceBucket);
+    }
+
+    const buckets = [serviceBucket];
+    if (apiKey) {
+      // Never keep raw keys in memory longer than needed
+      const keyId = `${service}:${crypto.createHash('sha256').update(apiKey).digest('hex').slice(0, 16)}`;
+      let keyBucket = this.keyBuckets.get(keyId);
+      if (!keyBucket) {
+        const keyLimit = this.keyLimits[service] || limit;
+        keyBucket = new TokenBucket(keyLimit.requests, keyLimit.window);
+        this.keyBuckets.set(keyId, keyBucket);
+      }
+      buckets.push(keyBucket);
+    }
+
+    return buckets;
+  }
+
+  // Resolve once the request may proceed; reject with RateLimitError when it cannot,
+  // or with the signal's reason when the caller gives up while waiting
+  acquire({ service, apiKey, priority = 0, signal }) {
+    if (signal && signal.aborted) return Promise.reject(signal.reason);
+
+    const buckets = this.bucketsFor(service, apiKey);
+    if (!buckets) return Promise.resolve(0);
+
+    const stats = this.serviceStats(service);
+    const queue = this.queues.get(service) || [];
+    this.queues.set(service, queue);
+
+    const now = Date.now();
+    if (queue.length === 0 && buckets.every((bucket) => bucket.available(now))) {
+      buckets.forEach((bucket) => bucket.take());
+      stats.granted++;
+      return Promise.resolve(0);
+    }
+
+    if (queue.length >= this.maxQueueDepth) {
+      stats.rejected++;
+      return Promise.reject(new RateLimitError(`Rate limit exceeded for ${service} (wait queue full)`));
+    }
+
+    return new Promise((resolve, reject) => {
+      const waiter = { buckets, priority, enqueuedAt: now, resolve, reject, timer: null };
+
+      // Insert after every waiter of equal or higher priority
+      let index = queue.length;
+      while (index > 0 && queue[index - 1].priority < priority) index--;
+      queue.splice(index, 0, waiter);
+
+      stats.queued++;
+      stats.maxQueueDepth = Math.max(stats.maxQueueDepth, queue.length);
+
+      waiter.timer = setTimeout(() => {
+        const position = queue.indexOf(waiter);
+        if (position === -1) return;
+        queue.splice(position, 1);
+        stats.rejected++;
+        reject(new RateLimitError(`Rate limit exceeded for ${service} (waited ${this.maxWaitMs} ms)`));
+        this.schedule(service);
+      }, this.maxWaitMs);
+
+      // A cancelled waiter leaves the queue without taking a token
+      if (signal) {
+        const onAbort = () => {
+          const position = queue.indexOf(waiter);
+          if (position === -1) return;
+          queue.splice(position, 1);
+          clearTimeout(waiter.timer);
+          stats.cancelled++;
+          reject(signal.reason);
+          this.schedule(service);
+        };
+        signal.addEventListener('abort', onAbort, { once: true });
+        waiter.resolve = (waitedMs) => {
+          signal.removeEventListener('abort', onAbort);
+          resolve(waitedMs);
+        };
+      }
+
+      this.schedule(service);
+    });
+  }
+
+  // Grant every waiter whose buckets have tokens, then sleep until the next token is due
+  drain(service) {
+    this.timers.delete(service);
+
+    const queue = this.queues.get(service);
+    if (!queue || queue.length === 0) return;
+
+    const stats = this.serviceStats(service);
+    const now = Date.now();
+    let nextWakeMs = Infinity;
+
+    for (let i = 0; i < queue.length;) {
+      const waiter = queue[i];
+      const waitMs = Math.max(...waiter.buckets.map((bucket) => bucket.msUntilAvailable(now)));
+
+      if (waitMs === 0) {
+        waiter.buckets.forEach((bucket) => bucket.take());
+        queue.splice(i, 1);
+        clearTimeout(waiter.timer);
+
+        const waitedMs = now - waiter.enqueuedAt;
+        stats.granted++;
+        stats.waited++;
+        stats.waitMsTotal += waitedMs;
+        stats.waitMsMax = Math.max(stats.waitMsMax, waitedMs);
+        waiter.resolve(waitedMs);
+        continue;
+      }
+
+      nextWakeMs = Math.min(nextWakeMs, waitMs);
+
+      // The shared service bucket is empty, nobody behind this waiter can go either
+      if (!waiter.buckets[0].available(now)) break;
+      i++;
+    }
+
+    if (queue.length > 0 && nextWakeMs !== Infinity) {
+      this.timers.set(service, setTimeout(() => this.drain(service), nextWakeMs));
+    }
+  }
+
+  schedule(service) {
+    const timer = this.timers.get(service);
+    if (timer) clearTimeout(timer);
+    this.timers.set(service, setTimeout(() => this.drain(service), 0));
+  }
+
+  getStats() {
+    const result = {};
+    for (const [service, limit] of Object.entries(this.limits)) {
+      const stats = this.serviceStats(service);
+      result[service] = {
+        limitPerMinute: Math.round(limit.requests * 60000 / limit.window),
+        queueDepth: (this.queues.get(service) || []).length,
+        ...stats,
+        avgWaitMs: stats.waited > 0 ? stats.waitMsTotal / stats.waited : 0
+      };
+    }
+    return result;
+  }
+}
+
+module.exports = { RateLimiter, RateLimitError, TokenBucket };
@@ -0,0 +1,194 @@
+const crypto = require('crypto');
+const fs = require('fs');
+const path = require('path');
+
+// Distinguishes temp files of concurrent writes to the same entry
+let tempFileCounter = 0;
+// Temp files older than this were left by a write that never got renamed into place
+const STALE_TEMP_FILE_MS = 60000;
+
+// Content-addressed response cache: an in-memory LRU in front of one JSON file per entry on disk.
+// Entries are keyed on the normalized provider request, so any change to service, model,
+// prompt or sampling settings produces a different key.
+class ResponseCache {
+  constructor({ dir, ttlMs, maxEntries, maxBytes, maxDiskEntries, logger }) {
+    this.dir = dir;
+    this.ttlMs = ttlMs;
+    this.maxEntries = maxEntries;
+    this.maxBytes = maxBytes;
+    this.maxDiskEntries = maxDiskEntries;
+    this.logger = logger;
+
+    this.memory = new Map();   // key -> { response, createdAt, size }, oldest first
+    this.memoryBytes = 0;
+    this.disk = new Map();     // key -> createdAt, oldest first
+    this.stats = { hits: 0, memoryHits: 0, diskHits: 0, misses: 0, bypassed: 0, stores: 0, evictions: 0, expired: 0 };
+
+    this.loadDiskIndex();
+  }
+
+  static keyFor({ service, endpoint, model, system, prompt, temperature, maxTokens, options }) {
+    const normalized = JSON.stringify([
+      service || '',
+      endpoint || '',
+      model || '',
+      prompt || '',
+      temperature === undefined || temperature === null ? null : Number(temperature),
+      maxTokens === undefined || maxTokens === null ? null : Number(maxTokens),
+      // Appended only when present so keys of requests without a preamble are unchanged
+      ...(system ? [system] : []),
+      // Ollama runtime options; a smaller num_ctx can truncate the prompt and change the answer
+      ...(options ? [{ options }] : [])
+    ]);
+    return crypto.createHash('sha256').update(normalized).digest('hex');
+  }
+
+  entryPath(key) {
+    return path.join(this.dir, `${key}.json`);
+  }
+
+  loadDiskIndex() {
+    fs.mkdirSync(this.dir, { recursive: true });
+
+    const entries = [];
+    for (const fileName of fs.readdirSync(this.dir)) {
+      if (fileName.endsWith('.tmp')) {
+        this.removeStaleTempFile(path.join(this.dir, fileName));
+        continue;
+      }
+      if (!fileName.endsWith('.json')) continue;
+      try {
+        entries.push({ key: fileName.slice(0, -5), createdAt: fs.statSync(path.join(this.dir, fileName)).mtimeMs });
+      } catch (error) {
+        // File vanished while scanning
+      }
+    }
+
+    entries.sort((a, b) => a.createdAt - b.createdAt);
+    for (const entry of entries) this.disk.set(entry.key, entry.createdAt);
+    this.pruneDisk();
+  }
+
+  // A crash between writing and renaming an entry leaves its temp file behind
+  removeStaleTempFile(filePath) {
+    try {
+      if (Date.now() - fs.statSync(filePath).mtimeMs > STALE_TEMP_FILE_MS) fs.unlinkSync(filePath);
+    } catch (error) {
+      // Renamed or removed while scanning
+    }
+  }
+
+  isExpired(createdAt) {
+    return Date.now() - createdAt > this.ttlMs;
+  }
+
+  // Resolve with the cached response text, or undefined on a miss
+  async get(key) {
+    const cached = this.memory.get(key);
+    if (cached) {
+      if (!this.isExpired(cached.createdAt)) {
+        // Refresh LRU position
+        this.memory.delete(key);
+        this.memory.set(key, cached);
+        this.stats.hits++;
+        this.stats.memoryHits++;
+        return cached.response;
+      }
+      this.removeFromMemory(key);
+      this.stats.expired++;
+    }
+
+    const diskCreatedAt = this.disk.get(key);
+    if (diskCreatedAt !== undefined) {
+      if (this.isExpired(diskCreatedAt)) {
+        this.removeFromDisk(key);
+        this.stats.expired++;
+      } else {
+        try {
+          const entry = JSON.parse(await fs.promises.readFile(this.entryPath(key), 'utf8'));
+          this.addToMemory(key, entry.response, entry.createdAt);
+          this.stats.hits++;
+          this.stats.diskHits++;
+          return entry.response;
+        } catch (error) {
+          this.disk.delete(key);
+        }
+      }
+    }
+
+    this.stats.misses++;
+    return undefined;
+  }
+
+  async set(key, response, metadata = {}) {
+    if (typeof response !== 'string') return;
+
+    const createdAt = Date.now();
+    this.addToMemory(key, response, createdAt);
+    this.stats.stores++;
+
+    try {
+      const entryPath = this.entryPath(key);
+      const tempPath = `${entryPath}.${process.pid}.${++tempFileCounter}.tmp`;
+      await fs.promises.writeFile(tempPath, JSON.stringify({ ...metadata, createdAt, response }));
+      await fs.promises.rename(tempPath, entryPath);
+
+      this.disk.delete(key);
+      this.disk.set(key, createdAt);
+      this.pruneDisk();
+    } catch (error) {
+      this.logger.warn(`Failed to persist cache entry ${key}: ${error.message}`);
+    }
+  }
+
+  noteBypass() {
+    this.stats.bypassed++;
+  }
+
+  addToMemory(key, response, createdAt) {
+    const size = Buffer.byteLength(response, 'utf8');
+    if (size > this.maxBytes) return;
+
+    this.removeFromMemory(key);
+    this.memory.set(key, { response, createdAt, size });
+    this.memoryBytes += size;
+
+    for (const oldestKey of this.memory.keys()) {
+      if (this.memory.size <= this.maxEntries && this.memoryBytes <= this.maxBytes) break;
+      this.removeFromMemory(oldestKey);
+      this.stats.evictions++;
+    }
+  }
+
+  removeFromMemory(key) {
+    const entry = this.memory.get(key);
+    if (!entry) return;
+    this.memory.delete(key);
+    this.memoryBytes -= entry.size;
+  }
+
+  removeFromDisk(key) {
+    this.disk.delete(key);
+    fs.promises.unlink(this.entryPath(key)).catch(() => {});
+  }
+
+  pruneDisk() {
+    for (const [key, createdAt] of this.disk) {
+      if (this.disk.size <= this.maxDiskEntries && !this.isExpired(createdAt)) break;
+      this.removeFromDisk(key);
+    }
+  }
+
+  getStats() {
+    const lookups = this.stats.hits + this.stats.misses;
+    return {
+      ...this.stats,
+      hitRatio: lookups > 0 ? this.stats.hits / lookups : 0,
+      memoryEntries: this.memory.size,
+      memoryBytes: this.memoryBytes,
+      diskEntries: this.disk.size
+    };
+  }
+}
+
+module.exports = { ResponseCache };
@@ -1,10 +1,18 @@
 const express = require('express');
 const cors = require('cors');
-const axios = require('axios');
 const fs = require('fs');
 const path = require('path');
-const chokidar = require('chokidar');
+const { monitorEventLoopDelay } = require('perf_hooks');
 const winston = require('winston');
+const { SpoolWorkerPool } = require('./spool');
+const { consumeProviderStream, normalizeUsage } = require('./streaming');
+const { ResponseCache } = require('./responseCache');
+const { ProviderConnectionPool } = require('./connectionPool');
+const { RateLimiter } = require('./rateLimiter');
+const { SingleFlight } = require('./singleFlight');
+const { ProviderBatchQueue } = require('./providerBatch');
+const { ProviderRouter } = require('./providerRouter');
+const { OllamaModelManager } = require('./ollamaModels');
 require('dotenv').config();
 
 const app = express();
@@ -26,6 +34,10 @@ const logger = winston.createLogger({
   ]
 });
 
+// Event-loop lag, reported on /health so blocking work on the request path shows up
+const eventLoopDelay = monitorEventLoopDelay({ resolution: 20 });
+eventLoopDelay.enable();
+
 // Middleware
 app.use(cors());
 app.use(express.json({ limit: '50mb' }));
@@ -58,19 +70,124 @@ const config = {
       }
     }
   },
+  // Requests per minute, per service and per API key
   rateLimits: {
-    claude: { requests: 100, window: 60000 }, // 100 requests per minute
-    openai: { requests: 60, window: 60000 },  // 60 requests per minute
-    ollama: { requests: 1000, window: 60000 } // 1000 requests per minute
+    claude: { requests: parseInt(process.env.CLAUDE_RATE_LIMIT, 10) || 100, window: 60000 },
+    openai: { requests: parseInt(process.env.OPENAI_RATE_LIMIT, 10) || 60, window: 60000 },
+    ollama: { requests: parseInt(process.env.OLLAMA_RATE_LIMIT, 10) || 1000, window: 60000 }
+  },
+  keyRateLimits: {
+    claude: { requests: parseInt(process.env.CLAUDE_KEY_RATE_LIMIT, 10) || parseInt(process.env.CLAUDE_RATE_LIMIT, 10) || 100, window: 60000 },
+    openai: { requests: parseInt(process.env.OPENAI_KEY_RATE_LIMIT, 10) || parseInt(process.env.OPENAI_RATE_LIMIT, 10) || 60, window: 60000 },
+    ollama: { requests: parseInt(process.env.OLLAMA_KEY_RATE_LIMIT, 10) || parseInt(process.env.OLLAMA_RATE_LIMIT, 10) || 1000, window: 60000 }
   }
 };
 
-// Rate limiting tracking
-const rateLimitTracking = {};
+// Token-bucket rate limiting; bursts wait in a bounded priority queue instead of failing
+const rateLimiter = new RateLimiter({
+  limits: config.rateLimits,
+  keyLimits: config.keyRateLimits,
+  maxQueueDepth: parseInt(process.env.RATE_LIMIT_QUEUE_DEPTH, 10) || 100,
+  maxWaitMs: parseInt(process.env.RATE_LIMIT_MAX_WAIT_MS, 10) || 30000,
+  logger
+});
+
+// Keep-alive (optionally HTTP/2) connections to the provider endpoints
+const providerPool = new ProviderConnectionPool({
+  keepAlive: process.env.HTTP_KEEP_ALIVE !== 'false',
+  maxSockets: parseInt(process.env.HTTP_MAX_SOCKETS, 10) || 16,
+  maxFreeSockets: parseInt(process.env.HTTP_MAX_FREE_SOCKETS, 10) || 4,
+  idleTimeoutMs: parseInt(process.env.HTTP_IDLE_TIMEOUT_MS, 10) || 30000,
+  http2: process.env.HTTP2_ENABLED === 'true',
+  logger
+});
+
+// Response cache keyed on the normalized provider request
+const responseCache = new ResponseCache({
+  dir: process.env.CACHE_DIR || path.join(__dirname, 'cache'),
+  ttlMs: parseInt(process.env.CACHE_TTL_MS, 10) || 24 * 60 * 60 * 1000,
+  maxEntries: parseInt(process.env.CACHE_MAX_ENTRIES, 10) || 500,
+  maxBytes: parseInt(process.env.CACHE_MAX_BYTES, 10) || 50 * 1024 * 1024,
+  maxDiskEntries: parseInt(process.env.CACHE_MAX_DISK_ENTRIES, 10) || 5000,
+  logger
+});
+
+// Identical requests arriving while the first is still running share its provider call
+const inFlight = new SingleFlight({ logger });
 
-// File-based communication system
-const REQUEST_FILE = path.join(config.armaProfilePath, 'ai_request.json');
-const RESPONSE_FILE = path.join(config.armaProfilePath, 'ai_response.json');
+// Provider batch APIs for batch-job requests (settings.batch), off by default
+const providerBatch = process.env.PROVIDER_BATCH_ENABLED === 'true'
+  ? new ProviderBatchQueue({
+    urls: {
+      claude: process.env.PROVIDER_BATCH_CLAUDE_URL || 'https://api.anthropic.com/v1/messages/batches',
+      openai: process.env.PROVIDER_BATCH_OPENAI_URL || 'https://api.openai.com/v1'
+    },
+    maxRequests: parseInt(process.env.PROVIDER_BATCH_MAX_REQUESTS, 10) || 1000,
+    maxWaitMs: parseInt(process.env.PROVIDER_BATCH_MAX_WAIT_MS, 10) || 60000,
+    pollIntervalMs: parseInt(process.env.PROVIDER_BATCH_POLL_MS, 10) || 30000,
+    logger
+  })
+  : null;
+
+// Local Ollama models: keep_alive, options and a warm pool of pre-loaded models
+const ollamaModels = new OllamaModelManager({
+  endpoint: config.aiServices.ollama.endpoint,
+  models: (process.env.OLLAMA_WARM_MODELS || '').split(',').map((model) => model.trim()).filter(Boolean),
+  keepAlive: process.env.OLLAMA_KEEP_ALIVE || '30m',
+  pingIntervalMs: parseInt(process.env.OLLAMA_PING_INTERVAL_MS, 10) || 240000,
+  numCtx: parseInt(process.env.OLLAMA_NUM_CTX, 10) || 0,
+  numThread: parseInt(process.env.OLLAMA_NUM_THREAD, 10) || 0,
+  logger
+});
+
+// Model used when a request does not name one
+const DEFAULT_MODELS = {
+  claude: 'claude-3-sonnet-20240229',
+  openai: 'gpt-3.5-turbo',
+  ollama: 'codellama'
+};
+
+// Alternate service:model targets for latency-aware routing, e.g.
+// "claude:claude-3-5-haiku-latest,ollama:codellama"; routing is off when empty.
+// Entries are checked once here so a typo is reported at startup instead of failing
+// every routed request. Custom targets are dropped: their endpoint comes with a request.
+const ROUTING_TARGETS = (process.env.ROUTING_TARGETS || '')
+  .split(',')
+  .map((entry) => entry.trim())
+  .filter(Boolean)
+  .map((entry) => {
+    const separator = entry.indexOf(':');
+    return separator === -1
+      ? { service: entry, model: null }
+      : { service: entry.slice(0, separator), model: entry.slice(separator + 1) || null };
+  })
+  .filter(({ service, model }) => {
+    try {
+      if (service === 'custom') throw new Error('custom endpoints can only be routed to per request');
+      resolveTarget(service, model);
+      return true;
+    } catch (error) {
+      logger.warn(`Ignoring routing target ${service}${model ? `:${model}` : ''}: ${error.message}`);
+      return false;
+    }
+  });
+
+const providerRouter = ROUTING_TARGETS.length > 0
+  ? new ProviderRouter({
+    windowSize: parseInt(process.env.ROUTING_WINDOW, 10) || 100,
+    hedging: process.env.ROUTING_HEDGE !== 'false',
+    hedgePercentile: parseInt(process.env.ROUTING_HEDGE_PERCENTILE, 10) || 95,
+    hedgeDelayMs: parseInt(process.env.ROUTING_HEDGE_DELAY_MS, 10) || 10000,
+    hedgeMinDelayMs: parseInt(process.env.ROUTING_HEDGE_MIN_DELAY_MS, 10) || 500,
+    failureThreshold: parseInt(process.env.ROUTING_FAILURE_THRESHOLD, 10) || 3,
+    cooldownMs: parseInt(process.env.ROUTING_COOLDOWN_MS, 10) || 30000,
+    logger
+  })
+  : null;
+
+// File-based communication system: <id>.req.json in, <id>.resp.json out
+const SPOOL_DIR = process.env.SPOOL_DIR || path.join(config.armaProfilePath, 'AIAssistantSpool');
+const SPOOL_WORKERS = parseInt(process.env.SPOOL_WORKERS, 10) || 4;
 
 // Ensure directories exist
 if (!fs.existsSync(config.armaProfilePath)) {
@@ -88,27 +205,35 @@ app.get('/health', (req, res) => {
       claude: !!config.aiServices.claude.apiKey,
       openai: !!config.aiServices.openai.apiKey,
       ollama: true
-    }
+    },
+    eventLoop: {
+      meanLagMs: eventLoopDelay.mean / 1e6,
+      p99LagMs: eventLoopDelay.percentile(99) / 1e6,
+      maxLagMs: eventLoopDelay.max / 1e6
+    },
+    spool: spool.getStats(),
+    cache: responseCache.getStats(),
+    coalescing: inFlight.getStats(),
+    connections: providerPool.getStats(),
+    rateLimits: rateLimiter.getStats(),
+    providerBatch: providerBatch ? providerBatch.getStats() : { enabled: false },
+    routing: providerRouter ? providerRouter.getStats() : { enabled: false },
+    ollama: ollamaModels.getStats()
   });
 });
 
 // Main AI request endpoint
 app.post('/api/ai-request', async (req, res) => {
   try {
-    const { service, prompt, model, settings } = req.body;
+    const { service, prompt } = req.body;
     
     if (!prompt) {
       return res.status(400).json({ error: 'Prompt is required' });
     }
     
-    // Check rate limits
-    if (!checkRateLimit(service)) {
-      return res.status(429).json({ error: 'Rate limit exceeded' });
-    }
-    
     logger.info(`Processing AI request for service: ${service}`);
     
-    const response = await processAIRequest(service, prompt, model, settings);
+    const response = await processAIRequest(req.body);
     
     res.json({ 
       success: true, 
@@ -119,51 +244,21 @@ app.post('/api/ai-request', async (req, res) => {
     
   } catch (error) {
     logger.error('AI request failed', error);
-    res.status(500).json({ 
-      error: 'AI request failed', 
+    res.status(error.statusCode || 500).json({ 
+      error: error.statusCode === 429 ? 'Rate limit exceeded' : 'AI request failed', 
       details: error.message 
     });
   }
 });
 
-// File-based communication endpoint
+// File-based communication endpoint: pick up any spooled requests the watcher missed
 app.post('/api/process-file-request', async (req, res) => {
   try {
-    if (!fs.existsSync(REQUEST_FILE)) {
-      return res.status(404).json({ error: 'No request file found' });
-    }
-    
-    const requestData = JSON.parse(fs.readFileSync(REQUEST_FILE, 'utf8'));
-    const response = await processAIRequest(
-      requestData.service, 
-      requestData.prompt, 
-      requestData.model, 
-      requestData.settings
-    );
-    
-    // Write response to file
-    fs.writeFileSync(RESPONSE_FILE, JSON.stringify({
-      response: response,
-      timestamp: new Date().toISOString(),
-      success: true
-    }, null, 2));
-    
-    // Clean up request file
-    fs.unlinkSync(REQUEST_FILE);
-    
-    res.json({ success: true, message: 'Request processed and response written to file' });
-    
+    const queued = await spool.rescan();
+    res.json({ success: true, queued: queued, spool: spool.getStats() });
   } catch (error) {
-    logger.error('File-based request failed', error);
-    
-    // Write error response to file
-    fs.writeFileSync(RESPONSE_FILE, JSON.stringify({
-      error: error.message,
-      timestamp: new Date().toISOString(),
-      success: false
-    }, null, 2));
-    
-    res.status(500).json({ error: 'File-based request failed', details: error.message });
+    logger.error('Spool rescan failed', error);
+    res.status(500).json({ error: 'Spool rescan failed', details: error.message });
   }
 });
 
@@ -172,12 +267,93 @@ app.get('/api/config', (req, res) => {
   res.json({
     services: Object.keys(config.aiServices),
     rateLimits: config.rateLimits,
-    profilePath: config.armaProfilePath
+    profilePath: config.armaProfilePath,
+    spoolDir: SPOOL_DIR
   });
 });
 
 // Process AI request based on service
-async function processAIRequest(service, prompt, model = null, settings = {}) {
+// The request carries an optional stable `system` preamble next to the variable
+// `prompt`. The preamble is sent as the provider's system prompt and, for Claude,
+// marked with cache_control so repeated preambles are served from the prompt cache.
+// When settings.stream is set and hooks.onChunk is given, the provider is asked to
+// stream and every text delta is reported through onChunk as it arrives.
+// Aborting hooks.signal cancels the call wherever it is: waiting for a rate-limit
+// token, waiting for the provider, or reading its stream.
+// hooks.onUsage receives the provider's { inputTokens, outputTokens, cachedInputTokens }
+// when known.
+// Requests with settings.batch go through the provider's batch API when it is enabled
+// (see usesProviderBatch) and resolve once their batch has ended.
+// With routing enabled the requested service and model are one candidate among the
+// ROUTING_TARGETS (see routingCandidates); the response is cached under the target
+// that answered, so a lookup for the requested target never returns another model's answer.
+async function processAIRequest({ service, system = '', prompt, model = null, settings = {} }, hooks = {}) {
+  const primary = resolveTarget(service, model, settings);
+  const streaming = !!(settings.stream && hooks.onChunk);
+  const request = { system, prompt, settings, streaming };
+  const payload = buildPayload(primary, request);
+
+  const cacheKey = cacheKeyFor(primary, payload, request);
+
+  if (settings.bypassCache) {
+    responseCache.noteBypass();
+  } else {
+    const cachedResponse = await responseCache.get(cacheKey);
+    if (cachedResponse !== undefined) {
+      logger.info(`Cache hit for service: ${primary.requestedService} (${cacheKey.slice(0, 12)})`);
+      return cachedResponse;
+    }
+  }
+
+  if (usesProviderBatch({ service: primary.requestedService, settings })) {
+    const result = await providerBatch.submit({ service: primary.service, apiKey: primary.apiKey, headers: primary.headers, payload }, hooks);
+    logger.info(`Provider batch request completed for service: ${primary.requestedService}`);
+    reportUsage(hooks, primary.requestedService, result.usage);
+    await responseCache.set(cacheKey, result.text, { service: primary.service, model: payload.model });
+    return result.text;
+  }
+
+  const callProvider = async (callHooks) => {
+    const result = providerRouter
+      ? await providerRouter.run(
+        routingCandidates(primary, settings),
+        (target, attemptHooks) => callTarget(target, target === primary ? payload : buildPayload(target, request), request, attemptHooks),
+        callHooks
+      )
+      : await callTarget(primary, payload, request, callHooks);
+
+    reportUsage(callHooks, result.target.requestedService, result.usage);
+    const answeredKey = result.target === primary ? cacheKey : cacheKeyFor(result.target, result.payload, request);
+    await responseCache.set(answeredKey, result.text, { service: result.target.service, model: result.target.model });
+    return result.text;
+  };
+
+  // A forced refresh gets its own call; everything else joins an identical call in flight.
+  // Streaming and non-streaming calls do not share a flight: a non-streaming flight
+  // has no chunks to hand a streaming caller.
+  if (settings.bypassCache) {
+    return callProvider(hooks);
+  }
+  return inFlight.run(streaming ? `${cacheKey}:stream` : cacheKey, callProvider, hooks);
+}
+
+// Response cache key of a request as sent to one target
+function cacheKeyFor(target, payload, { system, prompt, settings }) {
+  return ResponseCache.keyFor({
+    service: target.service,
+    endpoint: target.endpoint,
+    model: payload.model,
+    system,
+    prompt,
+    temperature: payload.temperature ?? settings.temperature,
+    maxTokens: payload.max_tokens ?? settings.maxTokens,
+    options: payload.options
+  });
+}
+
+// Endpoint, headers and model for a service; settings are the request's, and only
+// meant for the service it asked for
+function resolveTarget(service, model, settings = {}) {
   const requestedService = service || 'openai';
   let resolvedService = requestedService;
   let serviceConfig = config.aiServices[requestedService];
@@ -197,153 +373,211 @@ async function processAIRequest(service, prompt, model = null, settings = {}) {
     throw new Error(`Unsupported AI service: ${requestedService}`);
   }
 
+  if (!DEFAULT_MODELS[resolvedService]) {
+    throw new Error(`Unsupported service: ${resolvedService}`);
+  }
+
+  const headers = { ...(serviceConfig.headers || {}), ...(settings.headers || {}) };
+  const apiKey = settings.apiKey || serviceConfig.apiKey;
+
+  if (apiKey) {
+    if (resolvedService === 'claude') {
+      headers['x-api-key'] = apiKey;
+      headers['anthropic-version'] = headers['anthropic-version'] || '2023-06-01';
+    } else {
+      headers['Authorization'] = `Bearer ${apiKey}`;
+    }
+  }
+
+  if (!headers['Content-Type']) {
+    headers['Content-Type'] = 'application/json';
+  }
+
+  const endpoint = settings.endpoint || settings.customEndpoint || serviceConfig.endpoint;
+  const resolvedModel = model || DEFAULT_MODELS[resolvedService];
+
+  return {
+    key: requestedService === 'custom' ? `custom(${endpoint}):${resolvedModel}` : `${resolvedService}:${resolvedModel}`,
+    requestedService,
+    service: resolvedService,
+    model: resolvedModel,
+    endpoint,
+    headers,
+    apiKey
+  };
+}
+
+function buildPayload(target, { system, prompt, settings, streaming }) {
   let payload;
 
-  switch (resolvedService) {
+  switch (target.service) {
     case 'claude':
       payload = {
-        model: model || 'claude-3-sonnet-20240229',
+        model: target.model,
         max_tokens: settings.maxTokens || 4000,
-        messages: [{ role: 'user', content: prompt }]
+        messages: [{ role: 'user', content: prompt }],
+        stream: streaming
       };
+      if (system) {
+        payload.system = [{ type: 'text', text: system, cache_control: { type: 'ephemeral' } }];
+      }
+      if (settings.temperature !== undefined) {
+        payload.temperature = settings.temperature;
+      }
       break;
 
     case 'openai':
+      // OpenAI caches long identical prefixes automatically; the system message keeps it first
       payload = {
-        model: model || 'gpt-3.5-turbo',
-        messages: [{ role: 'user', content: prompt }],
+        model: target.model,
+        messages: system
+          ? [{ role: 'system', content: system }, { role: 'user', content: prompt }]
+          : [{ role: 'user', content: prompt }],
         max_tokens: settings.maxTokens || 4000,
-        temperature: settings.temperature || 0.7
+        temperature: settings.temperature ?? 0.7,
+        stream: streaming
       };
+      // Custom OpenAI-compatible servers may reject stream_options
+      if (streaming && target.requestedService === 'openai') {
+        payload.stream_options = { include_usage: true };
+      }
       break;
 
     case 'ollama':
       payload = {
-        model: model || 'codellama',
+        model: target.model,
         prompt: prompt,
-        stream: false
+        stream: streaming
       };
+      if (system) {
+        payload.system = system;
+      }
+      ollamaModels.apply(payload, settings);
       break;
-
-    default:
-      throw new Error(`Unsupported service: ${resolvedService}`);
   }
 
-  const headers = { ...(serviceConfig.headers || {}), ...(settings.headers || {}) };
-  const apiKey = settings.apiKey || serviceConfig.apiKey;
+  return payload;
+}
 
-  if (apiKey) {
-    if (resolvedService === 'claude') {
-      headers['x-api-key'] = apiKey;
-      headers['anthropic-version'] = headers['anthropic-version'] || '2023-06-01';
-    } else {
-      headers['Authorization'] = `Bearer ${apiKey}`;
-    }
+// One provider call: rate-limit token, request, response parsing.
+// Resolves with { text, usage, target, payload }.
+async function callTarget(target, payload, { settings, streaming }, hooks) {
+  const { requestedService, service } = target;
+
+  // Cache hits do not consume rate-limit tokens
+  const rateLimitWaitMs = await rateLimiter.acquire({
+    service: requestedService,
+    apiKey: target.apiKey,
+    priority: Number(settings.priority) || 0,
+    signal: hooks.signal
+  });
+  if (rateLimitWaitMs > 0) {
+    logger.info(`Rate limiter delayed ${requestedService} request by ${rateLimitWaitMs} ms`);
   }
 
-  if (!headers['Content-Type']) {
-    headers['Content-Type'] = 'application/json';
+  if (service === 'ollama') {
+    ollamaModels.noteRequest(target.model, payload.options);
   }
 
-  const endpoint = settings.endpoint || settings.customEndpoint || serviceConfig.endpoint;
-
   try {
-    const axiosResponse = await axios.post(endpoint, payload, {
-      headers,
-      timeout: settings.timeout || 60000
+    const providerResponse = await providerPool.post(target.endpoint, payload, {
+      headers: target.headers,
+      timeout: settings.timeout || 60000,
+      responseType: streaming ? 'stream' : 'json',
+      signal: hooks.signal
     });
 
+    if (streaming) {
+      const streamed = await consumeProviderStream(service, providerResponse.data, hooks.onChunk, hooks.signal);
+      logger.info(`AI stream completed for service: ${requestedService} (resolved as ${service})`);
+      if (service === 'ollama') ollamaModels.record(target.model, streamed.usage);
+      return { text: streamed.text, usage: streamed.usage, target, payload };
+    }
+
     // Extract response text based on service
     let responseText;
 
-    switch (resolvedService) {
+    switch (service) {
       case 'claude':
-        responseText = axiosResponse.data.content[0].text;
+        responseText = providerResponse.data.content[0].text;
         break;
       case 'openai':
-        responseText = axiosResponse.data.choices[0].message.content;
+        responseText = providerResponse.data.choices[0].message.content;
         break;
       case 'ollama':
-        responseText = axiosResponse.data.response;
+        responseText = providerResponse.data.response;
         break;
     }
 
     logger.info(
-      `AI request completed successfully for service: ${requestedService} (resolved as ${resolvedService})`
+      `AI request completed successfully for service: ${requestedService} (resolved as ${service})`
     );
-    return responseText;
-    
+    const usage = normalizeUsage(service, providerResponse.data);
+    if (service === 'ollama') ollamaModels.record(target.model, usage);
+    return { text: responseText, usage, target, payload };
+
   } catch (error) {
-    logger.error(`AI service error for ${service}:`, error.response?.data || error.message);
+    if (hooks.signal && hooks.signal.aborted) {
+      logger.info(`AI request for ${requestedService} cancelled`);
+      throw hooks.signal.reason;
+    }
+    logger.error(`AI service error for ${requestedService}:`, error.response?.data || error.message);
     throw new Error(`AI service error: ${error.response?.data?.error?.message || error.message}`);
   }
 }
 
-// Rate limiting
-function checkRateLimit(service) {
-  const limits = config.rateLimits[service];
-  if (!limits) return true;
-  
-  const now = Date.now();
-  const serviceTracking = rateLimitTracking[service] || { requests: [], count: 0 };
-  
-  // Remove expired requests
-  serviceTracking.requests = serviceTracking.requests.filter(
-    timestamp => now - timestamp < limits.window
-  );
-  
-  if (serviceTracking.requests.length >= limits.requests) {
-    return false;
+// The requested target first, then every configured alternate that has credentials.
+// The request's API key, endpoint and headers belong to the requested service, so
+// they carry over to alternates of that service (another model, say) but not to others.
+function routingCandidates(primary, settings = {}) {
+  const candidates = [primary];
+
+  for (const { service, model } of ROUTING_TARGETS) {
+    // A target the request's settings break is skipped; the primary can still answer
+    let target;
+    try {
+      target = resolveTarget(service, model, service === primary.requestedService ? settings : {});
+    } catch (error) {
+      logger.warn(`Skipping routing target ${service}:${model || DEFAULT_MODELS[service]}: ${error.message}`);
+      continue;
+    }
+    if (target.key === primary.key) continue;
+    if (target.service !== 'ollama' && !target.apiKey) continue;
+    candidates.push(target);
   }
-  
-  serviceTracking.requests.push(now);
-  rateLimitTracking[service] = serviceTracking;
-  
-  return true;
+
+  return candidates;
 }
 
-// File watcher for Arma integration
-const watcher = chokidar.watch(REQUEST_FILE, { ignoreInitial: true });
+// Batch-job requests to a provider with a batch API, unless a custom endpoint is set
+function usesProviderBatch({ service, settings = {} }) {
+  return !!(providerBatch &&
+    settings.batch &&
+    providerBatch.supports(service || 'openai') &&
+    !settings.endpoint &&
+    !settings.customEndpoint);
+}
 
-watcher.on('add', async () => {
-  logger.info('New request file detected, processing...');
-  
-  try {
-    // Wait a moment for file write to complete
-    await new Promise(resolve => setTimeout(resolve, 100));
-    
-    const requestData = JSON.parse(fs.readFileSync(REQUEST_FILE, 'utf8'));
-    const response = await processAIRequest(
-      requestData.service, 
-      requestData.prompt, 
-      requestData.model, 
-      requestData.settings
-    );
-    
-    // Write response
-    fs.writeFileSync(RESPONSE_FILE, JSON.stringify({
-      response: response,
-      timestamp: new Date().toISOString(),
-      success: true
-    }, null, 2));
-    
-    // Clean up request file
-    fs.unlinkSync(REQUEST_FILE);
-    
-    logger.info('File-based request processed successfully');
-    
-  } catch (error) {
-    logger.error('File-based request processing failed:', error);
-    
-    // Write error response
-    fs.writeFileSync(RESPONSE_FILE, JSON.stringify({
-      error: error.message,
-      timestamp: new Date().toISOString(),
-      success: false
-    }, null, 2));
-  }
+function reportUsage(hooks, service, usage) {
+  if (!usage) return;
+  const cached = usage.cachedInputTokens !== undefined ? ` (${usage.cachedInputTokens} cached)` : '';
+  const written = usage.cacheWriteTokens ? `, ${usage.cacheWriteTokens} written to prompt cache` : '';
+  logger.info(`Token usage for ${service}: ${usage.inputTokens ?? '?'} input${cached}, ${usage.outputTokens ?? '?'} output${written}`);
+  if (hooks.onUsage) hooks.onUsage(usage);
+}
+
+// Spool watcher for Arma integration, drained by a pool of workers
+const spool = new SpoolWorkerPool({
+  spoolDir: SPOOL_DIR,
+  concurrency: SPOOL_WORKERS,
+  logger,
+  handler: (requestData, id, hooks) => processAIRequest(requestData, hooks),
+  // Provider batches can take hours; they must not hold a worker meanwhile
+  runsDetached: (requestData) => usesProviderBatch(requestData)
 });
 
+spool.start();
+
 // Error handling middleware
 app.use((error, req, res, next) => {
   logger.error('Unhandled error:', error);
@@ -353,13 +587,17 @@ app.use((error, req, res, next) => {
 // Start server
 app.listen(PORT, () => {
   logger.info(`AI Bridge Service started on port ${PORT}`);
-  logger.info(`Watching for requests in: ${config.armaProfilePath}`);
+  logger.info(`Watching for requests in: ${SPOOL_DIR} (${SPOOL_WORKERS} workers)`);
   logger.info('Available services:', Object.keys(config.aiServices));
+  ollamaModels.start();
 });
 
 // Graceful shutdown
 process.on('SIGINT', () => {
   logger.info('Shutting down AI Bridge Service...');
-  watcher.close();
+  spool.close();
+  providerPool.close();
+  if (providerBatch) providerBatch.close();
+  ollamaModels.close();
   process.exit(0);
 });
\ No newline at end of file
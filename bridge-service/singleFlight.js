@@ -0,0 +1,89 @@
+// Single-flight coalescing of identical in-flight provider calls.
+// The first caller for a key runs the call; callers arriving before it settles
+// share its promise instead of starting another one. Streamed chunks are fanned
+// out to every caller, and chunks a late joiner missed are replayed first, so
+// each requester's stream ends up complete.
+// A caller whose hooks.signal aborts leaves the flight on its own; the shared call
+// is only aborted once every caller has left.
+class SingleFlight {
+  constructor({ logger } = {}) {
+    this.logger = logger;
+    this.flights = new Map();
+    this.stats = { started: 0, coalesced: 0, aborted: 0 };
+  }
+
+  // fn(hooks) performs the call; hooks.onChunk and hooks.onUsage reach every caller
+  // and hooks.signal aborts when no caller is left
+  run(key, fn, hooks = {}) {
+    if (hooks.signal && hooks.signal.aborted) return Promise.reject(hooks.signal.reason);
+
+    const existing = this.flights.get(key);
+    if (existing) {
+      this.stats.coalesced++;
+      existing.chunks.forEach((text) => hooks.onChunk && hooks.onChunk(text));
+      existing.callers.push(hooks);
+      if (this.logger) {
+        this.logger.info(`Coalesced request onto in-flight call ${key.slice(0, 12)} (${existing.callers.length} callers)`);
+      }
+      return this.attach(key, existing, hooks);
+    }
+
+    const controller = new AbortController();
+    const flight = { chunks: [], callers: [hooks], controller, promise: null };
+    const flightHooks = {
+      signal: controller.signal,
+      onChunk: (text) => {
+        flight.chunks.push(text);
+        flight.callers.forEach((caller) => caller.onChunk && caller.onChunk(text));
+      },
+      onUsage: (usage) => {
+        flight.callers.forEach((caller) => caller.onUsage && caller.onUsage(usage));
+      }
+    };
+
+    this.stats.started++;
+    flight.promise = Promise.resolve()
+      .then(() => fn(flightHooks))
+      .finally(() => {
+        if (this.flights.get(key) === flight) this.flights.delete(key);
+      });
+
+    this.flights.set(key, flight);
+    return this.attach(key, flight, hooks);
+  }
+
+  // The caller's view of the flight: settles with it, or rejects early on the caller's abort
+  attach(key, flight, hooks) {
+    const { signal } = hooks;
+    if (!signal) return flight.promise;
+
+    return new Promise((resolve, reject) => {
+      const onAbort = () => {
+        flight.callers = flight.callers.filter((caller) => caller !== hooks);
+        if (flight.callers.length === 0) {
+          // Nobody is waiting any more; later identical requests start afresh
+          if (this.flights.get(key) === flight) this.flights.delete(key);
+          this.stats.aborted++;
+          flight.controller.abort(signal.reason);
+        }
+        reject(signal.reason);
+      };
+
+      signal.addEventListener('abort', onAbort, { once: true });
+      flight.promise
+        .finally(() => signal.removeEventListener('abort', onAbort))
+        .then(resolve, reject);
+    });
+  }
+
+  getStats() {
+    return {
+      inFlight: this.flights.size,
+      started: this.stats.started,
+      coalesced: this.stats.coalesced,
+      aborted: this.stats.aborted
+    };
+  }
+}
+
+module.exports = { SingleFlight };
@@ -0,0 +1,389 @@
+const fs = require('fs');
+const path = require('path');
+const chokidar = require('chokidar');
+
+// Spool directory protocol shared with the Workbench plugin:
+//   <id>.req.json   request body written by the plugin
+//   <id>.req.ready  empty marker written once the body is complete
+//   <id>.resp.json  response, written to a temp file and renamed into place
+//   <id>.stream     streamed text, appended chunk by chunk while the provider answers
+//   <id>.stream.len committed byte length of <id>.stream, rewritten atomically after each append
+//   <id>.cancel     empty marker written by the plugin to abandon a request; no response follows
+//   bridge.seq      counter bumped after every response or stream flush so the plugin can poll one tiny file
+const REQUEST_SUFFIX = '.req.json';
+const READY_SUFFIX = '.req.ready';
+const RESPONSE_SUFFIX = '.resp.json';
+const STREAM_SUFFIX = '.stream';
+const STREAM_LENGTH_SUFFIX = '.stream.len';
+const CANCEL_SUFFIX = '.cancel';
+const SEQUENCE_FILE = 'bridge.seq';
+const STREAM_FLUSH_INTERVAL_MS = 100;
+// Cancelled ids remembered in case their ready marker shows up after the cancel marker
+const MAX_REMEMBERED_CANCELS = 1000;
+
+let tempFileCounter = 0;
+
+// Write a file so readers only ever observe the complete content
+async function writeFileAtomic(filePath, content) {
+  const tempPath = `${filePath}.${process.pid}.${++tempFileCounter}.tmp`;
+  await fs.promises.writeFile(tempPath, content);
+  await fs.promises.rename(tempPath, filePath);
+}
+
+async function removeIfExists(filePath) {
+  try {
+    await fs.promises.unlink(filePath);
+  } catch (error) {
+    if (error.code !== 'ENOENT') throw error;
+  }
+}
+
+function cancellationError() {
+  const error = new Error('Request cancelled');
+  error.name = 'AbortError';
+  return error;
+}
+
+// Requests are started in priority order (settings.priority, higher first, FIFO
+// within a priority) by a fixed number of workers. A cancel marker drops a queued
+// request or aborts a running one through its AbortController.
+// Requests for which runsDetached(requestData) is true start right away without
+// taking a worker, for calls that wait a long time without doing any work.
+class SpoolWorkerPool {
+  constructor({ spoolDir, concurrency, handler, logger, streamFlushIntervalMs, runsDetached }) {
+    this.spoolDir = spoolDir;
+    this.streamFlushIntervalMs = streamFlushIntervalMs || STREAM_FLUSH_INTERVAL_MS;
+    this.concurrency = Math.max(1, concurrency || 1);
+    this.handler = handler;
+    this.runsDetached = runsDetached || (() => false);
+    this.logger = logger;
+    this.queue = [];
+    this.known = new Set();
+    this.cancelled = new Set();
+    this.controllers = new Map();
+    this.active = 0;
+    this.detached = 0;
+    this.watcher = null;
+    this.sequence = 0;
+    this.sequenceWrite = null;
+    this.sequenceDirty = false;
+    this.stats = { processed: 0, failed: 0, cancelled: 0 };
+  }
+
+  requestPath(id) { return path.join(this.spoolDir, id + REQUEST_SUFFIX); }
+  readyPath(id) { return path.join(this.spoolDir, id + READY_SUFFIX); }
+  responsePath(id) { return path.join(this.spoolDir, id + RESPONSE_SUFFIX); }
+  streamPath(id) { return path.join(this.spoolDir, id + STREAM_SUFFIX); }
+  streamLengthPath(id) { return path.join(this.spoolDir, id + STREAM_LENGTH_SUFFIX); }
+  cancelPath(id) { return path.join(this.spoolDir, id + CANCEL_SUFFIX); }
+
+  start() {
+    fs.mkdirSync(this.spoolDir, { recursive: true });
+
+    // Continue from the previous value so a restarted bridge still looks like a change
+    try {
+      this.sequence = parseInt(fs.readFileSync(path.join(this.spoolDir, SEQUENCE_FILE), 'utf8'), 10) || 0;
+    } catch (error) {
+      this.sequence = 0;
+    }
+
+    // ignoreInitial is off so requests spooled while the bridge was down are drained on start
+    this.watcher = chokidar.watch(this.spoolDir, { depth: 0 });
+    this.watcher.on('add', (filePath) => {
+      const fileName = path.basename(filePath);
+      if (fileName.endsWith(READY_SUFFIX)) {
+        this.enqueue(fileName.slice(0, -READY_SUFFIX.length));
+      } else if (fileName.endsWith(CANCEL_SUFFIX)) {
+        this.cancel(fileName.slice(0, -CANCEL_SUFFIX.length));
+      }
+    });
+    this.watcher.on('error', (error) => this.logger.error('Spool watcher error:', error));
+  }
+
+  close() {
+    if (this.watcher) {
+      this.watcher.close();
+      this.watcher = null;
+    }
+  }
+
+  // Enqueue every request whose ready marker is already on disk
+  async rescan() {
+    let added = 0;
+    const fileNames = await fs.promises.readdir(this.spoolDir);
+    for (const fileName of fileNames) {
+      if (fileName.endsWith(CANCEL_SUFFIX)) this.cancel(fileName.slice(0, -CANCEL_SUFFIX.length));
+    }
+    for (const fileName of fileNames) {
+      if (fileName.endsWith(READY_SUFFIX) && this.enqueue(fileName.slice(0, -READY_SUFFIX.length))) {
+        added++;
+      }
+    }
+    return added;
+  }
+
+  enqueue(id) {
+    if (this.known.has(id)) return false;
+
+    if (this.cancelled.has(id)) {
+      this.cancelled.delete(id);
+      this.discard(id);
+      return false;
+    }
+
+    this.known.add(id);
+
+    // The ready marker is only written after the body is closed, so the body is complete.
+    // The body is read up front for its priority; a body that fails to load is queued
+    // anyway so run() reports the error.
+    fs.promises.readFile(this.requestPath(id), 'utf8')
+      .then((content) => JSON.parse(content))
+      .catch(() => null)
+      .then((requestData) => {
+        if (this.cancelled.has(id)) {
+          this.cancelled.delete(id);
+          this.known.delete(id);
+          this.discard(id);
+          return;
+        }
+
+        if (requestData && this.runsDetached(requestData)) {
+          this.detached++;
+          this.run({ id, priority: 0, requestData }).finally(() => {
+            this.detached--;
+            this.known.delete(id);
+          });
+          return;
+        }
+
+        const priority = Number(requestData?.settings?.priority) || 0;
+        let index = this.queue.length;
+        while (index > 0 && this.queue[index - 1].priority < priority) index--;
+        this.queue.splice(index, 0, { id, priority, requestData });
+        this.pump();
+      });
+    return true;
+  }
+
+  // Drop a queued request or abort a running one; the plugin expects no response
+  cancel(id) {
+    removeIfExists(this.cancelPath(id)).catch(() => {});
+
+    const controller = this.controllers.get(id);
+    if (controller) {
+      controller.abort(cancellationError());
+      return;
+    }
+
+    const index = this.queue.findIndex((entry) => entry.id === id);
+    if (index !== -1) {
+      this.queue.splice(index, 1);
+      this.known.delete(id);
+      this.stats.cancelled++;
+      this.logger.info(`Spool request ${id} cancelled before it started`);
+      this.discard(id);
+      return;
+    }
+
+    // Not seen yet, its body is still loading, or it was already answered; any
+    // response written before the cancel arrived is never read
+    this.cancelled.add(id);
+    if (this.cancelled.size > MAX_REMEMBERED_CANCELS) {
+      this.cancelled.delete(this.cancelled.values().next().value);
+    }
+    this.discard(id);
+  }
+
+  // Remove every spool file of a request that will not be answered, output included
+  discard(id) {
+    Promise.all([
+      removeIfExists(this.readyPath(id)),
+      removeIfExists(this.requestPath(id)),
+      removeIfExists(this.responsePath(id)),
+      removeIfExists(this.streamPath(id)),
+      removeIfExists(this.streamLengthPath(id))
+    ]).catch((error) => this.logger.warn(`Failed to remove cancelled request ${id}: ${error.message}`));
+  }
+
+  pump() {
+    while (this.active < this.concurrency && this.queue.length > 0) {
+      const entry = this.queue.shift();
+      this.active++;
+      this.run(entry).finally(() => {
+        this.active--;
+        this.known.delete(entry.id);
+        this.pump();
+      });
+    }
+  }
+
+  async run({ id, requestData: preloaded }) {
+    let requestData = preloaded;
+    let streamWriter = null;
+    const controller = new AbortController();
+    this.controllers.set(id, controller);
+
+    try {
+      if (!requestData) {
+        requestData = JSON.parse(await fs.promises.readFile(this.requestPath(id), 'utf8'));
+      }
+
+      let usage = null;
+      const hooks = { signal: controller.signal, onUsage: (reported) => { usage = reported; } };
+      if (requestData.settings && requestData.settings.stream) {
+        streamWriter = this.createStreamWriter(id);
+        hooks.onChunk = (text) => streamWriter.write(text);
+      }
+
+      const response = await this.handler(requestData, id, hooks);
+
+      // Partial chunks must be on disk before the final response appears
+      if (streamWriter) await streamWriter.close();
+
+      await writeFileAtomic(this.responsePath(id), JSON.stringify({
+        requestId: id,
+        response: response,
+        ...(usage ? { usage } : {}),
+        timestamp: new Date().toISOString(),
+        success: true
+      }, null, 2));
+
+      this.stats.processed++;
+      this.logger.info(`Spool request ${id} processed successfully`);
+    } catch (error) {
+      if (streamWriter) await streamWriter.close();
+
+      if (controller.signal.aborted) {
+        this.controllers.delete(id);
+        this.stats.cancelled++;
+        this.logger.info(`Spool request ${id} cancelled`);
+        this.discard(id);
+        this.cancelled.delete(id);
+        return;
+      }
+
+      this.stats.failed++;
+      this.logger.error(`Spool request ${id} failed:`, error);
+
+      try {
+        await writeFileAtomic(this.responsePath(id), JSON.stringify({
+          requestId: id,
+          error: error.message,
+          timestamp: new Date().toISOString(),
+          success: false
+        }, null, 2));
+      } catch (writeError) {
+        this.logger.error(`Failed to write error response for ${id}:`, writeError);
+      }
+    }
+
+    this.controllers.delete(id);
+
+    // Cancelled while the response was being written; the plugin no longer reads it
+    if (controller.signal.aborted) {
+      this.stats.cancelled++;
+      this.logger.info(`Spool request ${id} cancelled after it was answered`);
+      this.discard(id);
+      this.cancelled.delete(id);
+      return;
+    }
+
+    try {
+      await Promise.all([removeIfExists(this.readyPath(id)), removeIfExists(this.requestPath(id))]);
+    } catch (error) {
+      this.logger.warn(`Failed to remove spooled request ${id}: ${error.message}`);
+    }
+
+    await this.bumpSequence();
+  }
+
+  // Append streamed text to <id>.stream, publishing the committed length at most
+  // once per flush interval. The plugin removes the stream files once it is done.
+  createStreamWriter(id) {
+    const streamPath = this.streamPath(id);
+    const lengthPath = this.streamLengthPath(id);
+    let pending = [];
+    let committed = 0;
+    let timer = null;
+
+    // Appends are chained so chunks land in order and the length never runs ahead of the data
+    let chain = fs.promises.writeFile(streamPath, '');
+
+    const flush = () => {
+      timer = null;
+      if (pending.length === 0) return chain;
+
+      const text = pending.join('');
+      pending = [];
+
+      chain = chain
+        .then(async () => {
+          await fs.promises.appendFile(streamPath, text);
+          committed += Buffer.byteLength(text, 'utf8');
+          await writeFileAtomic(lengthPath, String(committed));
+          await this.bumpSequence();
+        })
+        .catch((error) => this.logger.error(`Failed to append stream chunk for ${id}:`, error));
+      return chain;
+    };
+
+    return {
+      write: (text) => {
+        pending.push(text);
+        if (!timer) timer = setTimeout(flush, this.streamFlushIntervalMs);
+      },
+      close: () => {
+        if (timer) clearTimeout(timer);
+        return flush();
+      }
+    };
+  }
+
+  // Writes are serialized and coalesced so an older value can never be renamed over a newer one
+  bumpSequence() {
+    this.sequence++;
+    if (this.sequenceWrite) {
+      this.sequenceDirty = true;
+      return this.sequenceWrite;
+    }
+
+    this.sequenceWrite = (async () => {
+      do {
+        this.sequenceDirty = false;
+        try {
+          await writeFileAtomic(path.join(this.spoolDir, SEQUENCE_FILE), String(this.sequence));
+        } catch (error) {
+          this.logger.error('Failed to update spool sequence file:', error);
+        }
+      } while (this.sequenceDirty);
+      this.sequenceWrite = null;
+    })();
+    return this.sequenceWrite;
+  }
+
+  getStats() {
+    return {
+      directory: this.spoolDir,
+      workers: this.concurrency,
+      active: this.active,
+      queued: this.queue.length,
+      detached: this.detached,
+      sequence: this.sequence,
+      processed: this.stats.processed,
+      failed: this.stats.failed,
+      cancelled: this.stats.cancelled
+    };
+  }
+}
+
+module.exports = {
+  SpoolWorkerPool,
+  writeFileAtomic,
+  REQUEST_SUFFIX,
+  READY_SUFFIX,
+  RESPONSE_SUFFIX,
+  STREAM_SUFFIX,
+  STREAM_LENGTH_SUFFIX,
+  CANCEL_SUFFIX,
+  SEQUENCE_FILE
+};
@@ -0,0 +1,183 @@
+const { StringDecoder } = require('string_decoder');
+
+// Parse one line of a provider stream into its event object.
+// Claude and OpenAI send SSE ("data: {...}"), Ollama sends NDJSON.
+function parseStreamEvent(service, line) {
+  if (!line) return null;
+
+  if (service === 'ollama') {
+    const event = JSON.parse(line);
+    if (event.error) throw new Error(event.error);
+    return event;
+  }
+
+  if (!line.startsWith('data:')) return null;
+
+  const data = line.slice(5).trim();
+  if (!data || data === '[DONE]') return null;
+
+  const event = JSON.parse(data);
+
+  if (service === 'claude') {
+    if (event.type === 'error') throw new Error(event.error?.message || 'Stream error');
+  } else if (event.error) {
+    throw new Error(event.error.message || 'Stream error');
+  }
+
+  return event;
+}
+
+// Pull the text delta out of one stream event
+function extractStreamText(service, event) {
+  if (!event) return null;
+  if (service === 'ollama') return event.response || null;
+  if (service === 'claude') {
+    return event.type === 'content_block_delta' ? event.delta?.text || null : null;
+  }
+  return event.choices?.[0]?.delta?.content || null;
+}
+
+// Token counts carried by a stream event, normalized to { inputTokens, outputTokens }
+function extractStreamUsage(service, event) {
+  if (!event) return null;
+
+  if (service === 'ollama') {
+    return event.done ? normalizeUsage(service, event) : null;
+  }
+
+  if (service === 'claude') {
+    if (event.type === 'message_start') return normalizeUsage(service, event.message);
+    if (event.type === 'message_delta') return normalizeUsage(service, event);
+    return null;
+  }
+
+  return event.usage ? normalizeUsage(service, event) : null;
+}
+
+// Token counts of a complete (non-streamed) provider response body.
+// inputTokens is always the full prompt size; cachedInputTokens is the part served
+// from the provider's prompt cache and cacheWriteTokens the part newly cached.
+// For Ollama, loadMs, promptEvalMs and evalMs split the time between loading the
+// model and running it (Ollama reports nanoseconds).
+function normalizeUsage(service, body) {
+  if (!body) return null;
+
+  let inputTokens;
+  let outputTokens;
+  let cachedInputTokens;
+  let cacheWriteTokens;
+  let timings;
+
+  if (service === 'ollama') {
+    inputTokens = body.prompt_eval_count;
+    outputTokens = body.eval_count;
+    if (body.load_duration !== undefined) {
+      timings = {
+        loadMs: Math.round(body.load_duration / 1e6),
+        promptEvalMs: Math.round((body.prompt_eval_duration || 0) / 1e6),
+        evalMs: Math.round((body.eval_duration || 0) / 1e6)
+      };
+    }
+  } else if (service === 'claude') {
+    // Claude's input_tokens excludes cache reads and writes
+    cachedInputTokens = body.usage?.cache_read_input_tokens;
+    cacheWriteTokens = body.usage?.cache_creation_input_tokens;
+    if (body.usage?.input_tokens !== undefined) {
+      inputTokens = body.usage.input_tokens + (cachedInputTokens || 0) + (cacheWriteTokens || 0);
+    }
+    outputTokens = body.usage?.output_tokens;
+  } else {
+    inputTokens = body.usage?.prompt_tokens;
+    outputTokens = body.usage?.completion_tokens;
+    cachedInputTokens = body.usage?.prompt_tokens_details?.cached_tokens;
+  }
+
+  if (inputTokens === undefined && outputTokens === undefined && !timings) return null;
+
+  const usage = { ...timings };
+  if (inputTokens !== undefined) usage.inputTokens = inputTokens;
+  if (outputTokens !== undefined) usage.outputTokens = outputTokens;
+  if (cachedInputTokens !== undefined && cachedInputTokens !== null) usage.cachedInputTokens = cachedInputTokens;
+  if (cacheWriteTokens) usage.cacheWriteTokens = cacheWriteTokens;
+  return usage;
+}
+
+// Consume a provider response stream, reporting each text delta and resolving with
+// { text, usage }; usage merges the token counts seen across the stream.
+// Aborting signal destroys the stream and rejects with the signal's reason.
+function consumeProviderStream(service, stream, onText, signal) {
+  return new Promise((resolve, reject) => {
+    const decoder = new StringDecoder('utf8');
+    const parts = [];
+    let usage = null;
+    let buffer = '';
+    let failed = false;
+
+    const handleLine = (rawLine) => {
+      const event = parseStreamEvent(service, rawLine.replace(/\r$/, ''));
+      const text = extractStreamText(service, event);
+      if (text) {
+        parts.push(text);
+        onText(text);
+      }
+
+      const eventUsage = extractStreamUsage(service, event);
+      if (eventUsage) usage = { ...usage, ...eventUsage };
+    };
+
+    const fail = (error) => {
+      if (failed) return;
+      failed = true;
+      if (signal) signal.removeEventListener('abort', onAbort);
+      stream.destroy();
+      reject(error);
+    };
+
+    const onAbort = () => fail(signal.reason);
+    if (signal) {
+      if (signal.aborted) {
+        fail(signal.reason);
+        return;
+      }
+      signal.addEventListener('abort', onAbort, { once: true });
+    }
+
+    stream.on('data', (chunk) => {
+      if (failed) return;
+      buffer += decoder.write(chunk);
+
+      try {
+        let newline;
+        while ((newline = buffer.indexOf('\n')) !== -1) {
+          const line = buffer.slice(0, newline);
+          buffer = buffer.slice(newline + 1);
+          handleLine(line);
+        }
+      } catch (error) {
+        fail(error);
+      }
+    });
+
+    stream.on('end', () => {
+      if (failed) return;
+      try {
+        buffer += decoder.end();
+        if (buffer) handleLine(buffer);
+        if (signal) signal.removeEventListener('abort', onAbort);
+        resolve({ text: parts.join(''), usage });
+      } catch (error) {
+        fail(error);
+      }
+    });
+
+    stream.on('error', fail);
+  });
+}
+
+module.exports = {
+  parseStreamEvent,
+  extractStreamText,
+  extractStreamUsage,
+  normalizeUsage,
+  consumeProviderStream
+};
@@ -0,0 +1,87 @@
+const assert = require('assert');
+const { ProviderRouter } = require('./providerRouter');
+
+const logger = { info: () => {}, warn: () => {}, error: () => {} };
+
+function sleep(ms, signal) {
+  return new Promise((resolve, reject) => {
+    const timer = setTimeout(resolve, ms);
+    if (signal) {
+      signal.addEventListener('abort', () => {
+        clearTimeout(timer);
+        reject(signal.reason);
+      }, { once: true });
+    }
+  });
+}
+
+// Attempts that answer after latency[key] ms, or fail when failing[key] is set
+function stubAttempt(latency, failing) {
+  return async (target, hooks) => {
+    await sleep(latency[target.key], hooks.signal);
+    if (failing[target.key]) throw new Error(`${target.key} failed`);
+    return { text: target.key, target };
+  };
+}
+
+const tests = [
+  ['a half-open probe that loses the hedge race lets the next request probe again', async () => {
+    const router = new ProviderRouter({ failureThreshold: 1, cooldownMs: 20, hedgeDelayMs: 10, logger });
+    const slow = { key: 'slow' };
+    const fast = { key: 'fast' };
+    const latency = { slow: 50, fast: 5 };
+    const failing = { slow: true, fast: false };
+    const attempt = stubAttempt(latency, failing);
+
+    await assert.rejects(router.run([slow], attempt));
+    assert.strictEqual(router.stateFor('slow').breaker, 'open');
+
+    await sleep(30);
+    failing.slow = false;
+    const result = await router.run([slow, fast], attempt);
+    assert.strictEqual(result.text, 'fast');
+
+    // Let the aborted probe settle
+    await sleep(0);
+    assert.strictEqual(router.stateFor('slow').breaker, 'half-open');
+    assert.strictEqual(router.available('slow'), true);
+
+    const probe = await router.run([slow], attempt);
+    assert.strictEqual(probe.text, 'slow');
+    assert.strictEqual(router.stateFor('slow').breaker, 'closed');
+  }],
+
+  ['a half-open probe cancelled by the caller lets the next request probe again', async () => {
+    const router = new ProviderRouter({ failureThreshold: 1, cooldownMs: 20, hedging: false, logger });
+    const target = { key: 'target' };
+    const failing = { target: true };
+    const attempt = stubAttempt({ target: 20 }, failing);
+
+    await assert.rejects(router.run([target], attempt));
+    await sleep(30);
+    failing.target = false;
+
+    const controller = new AbortController();
+    const cancelled = router.run([target], attempt, { signal: controller.signal });
+    controller.abort(new Error('cancelled'));
+    await assert.rejects(cancelled, /cancelled/);
+
+    await sleep(0);
+    assert.strictEqual(router.available('target'), true);
+  }]
+];
+
+(async () => {
+  let failed = 0;
+  for (const [name, run] of tests) {
+    try {
+      await run();
+      console.log(`ok - ${name}`);
+    } catch (error) {
+      failed++;
+      console.log(`not ok - ${name}`);
+      console.log(error);
+    }
+  }
+  process.exitCode = failed > 0 ? 1 : 0;
+})();